@@ -7,5 +7,5 @@ layout(set = 0, binding = 0) uniform UniformBufferObject0 {
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(1.0, 1.0, 1.0, 1.0);
+    outColor = vec4(color, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,513 @@
+#include <vulkan/vulkan_raii.hpp>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "instance.hh"
+#include "device.hh"
+#include "offscreen_target.hh"
+#include "scene.hh"
+#include "renderer.hh"
+#include "frame_pacer.hh"
+#include "frame_timer.hh"
+#include "json_writer.hh"
+#include "options.hh"
+
+// Runs synthetic scenes headless for a fixed number of frames and reports CPU and GPU frame
+// times, every combination of the listed parameters is a separate run.
+struct BenchOptions {
+    std::vector<uint32_t> drawCounts = {1, 100, 1000};
+    std::vector<uint32_t> trianglesPerDraw = {2, 512};
+    std::vector<render::VertexFormat> vertexFormats = {render::VertexFormat::BASIC};
+    std::vector<uint32_t> framesInFlight = {2};
+    std::vector<uint32_t> recordThreads = {1};
+    bool staticCommands = false;
+    uint64_t warmupFrames = 50;
+    uint64_t frameCount = 500;
+    uint32_t width = 800;
+    uint32_t height = 450;
+    std::string deviceSelector;
+    render::SharingMode sharingMode = render::SharingMode::CONCURRENT;
+    uint32_t jobWorkers = render::JobSystem::defaultWorkerCount();
+    std::string csvPath;
+    std::string jsonPath;
+    std::string baselinePath; // CSV written by a previous run
+    double tolerance = 0.1;   // allowed relative slowdown against the baseline
+    uint64_t allocationCycles = 0; // buffers created per allocation pattern, 0 skips them
+};
+
+// Cost of creating and destroying one host buffer with a given pool and pattern
+struct AllocationResult {
+    std::string name;
+    double nsPerBuffer;
+};
+
+struct BenchResult {
+    std::string name;
+    render::SceneParameters scene;
+    uint32_t framesInFlight;
+    uint32_t recordThreads;
+    bool staticCommands;
+    uint64_t frames;
+    // FrameRecord::cpuWorkTime, the frame time minus the waits, not the thread CPU time
+    render::TimingSummary work;
+    render::TimingSummary frame;
+    render::TimingSummary gpu;
+    bool gpuResolved;
+};
+
+static void printUsage(const char* program) {
+    std::cout << "Usage : " << program << " [options]\n"
+              << "  --draws N[,N...]           draw calls per frame (default 1,100,1000)\n"
+              << "  --triangles N[,N...]       triangles per draw (default 2,512)\n"
+              << "  --vertex-format F[,F...]   basic or compact (default basic)\n"
+              << "  --frames-in-flight N[,N...] frames recorded ahead of the GPU (default 2)\n"
+              << "  --record-threads N[,N...] threads recording the draws, 1 inline (default 1)\n"
+              << "  --static                   record the draws once and replay them, not with\n"
+              << "                             --record-threads\n"
+              << "  --warmup N                 frames rendered before measuring (default 50)\n"
+              << "  --frames N                 frames measured per run (default 500)\n"
+              << "  --size WxH                 render target size (default 800x450)\n"
+              << "  --device SELECTOR          physical device index, UUID or name substring\n"
+              << "  --sharing MODE             concurrent or exclusive buffer sharing (default "
+                 "concurrent)\n"
+              << "  --jobs N                   job system workers (default one per core minus "
+                 "one)\n"
+              << "  --csv FILE.csv             write one line per run\n"
+              << "  --json FILE.json           write every run with its full summaries\n"
+              << "  --baseline FILE.csv        fail when a run is slower than in this CSV\n"
+              << "  --tolerance RATIO          allowed slowdown against the baseline (default "
+                 "0.1)\n"
+              << "  --allocations N            time N buffer creations with the linear pools and\n"
+              << "                             with the default heuristics before the runs\n"
+              << "  --help                     print this message\n";
+}
+
+using render::nextArgument;
+
+static std::vector<std::string> splitList(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    if (items.empty()) throw std::runtime_error("empty list " + list);
+    return items;
+}
+
+static std::vector<uint32_t> parseCountList(const std::string& list, const char* option) {
+    std::vector<uint32_t> counts;
+    for (const std::string& item : splitList(list)) {
+        int value = std::stoi(item);
+        if (value < 1) throw std::runtime_error(std::string(option) + " must be positive");
+        counts.push_back((uint32_t)value);
+    }
+    return counts;
+}
+
+static BenchOptions parseBenchOptions(int argc, char** argv) {
+    BenchOptions options;
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--draws") {
+                options.drawCounts = parseCountList(nextArgument(argc, argv, i), "--draws");
+            } else if (arg == "--triangles") {
+                options.trianglesPerDraw =
+                    parseCountList(nextArgument(argc, argv, i), "--triangles");
+            } else if (arg == "--vertex-format") {
+                options.vertexFormats.clear();
+                for (const std::string& item : splitList(nextArgument(argc, argv, i))) {
+                    options.vertexFormats.push_back(render::parseVertexFormat(item));
+                }
+            } else if (arg == "--frames-in-flight") {
+                options.framesInFlight =
+                    parseCountList(nextArgument(argc, argv, i), "--frames-in-flight");
+                for (uint32_t value : options.framesInFlight) {
+                    if (value > 8) {
+                        throw std::runtime_error("--frames-in-flight must be between 1 and 8");
+                    }
+                }
+            } else if (arg == "--record-threads") {
+                options.recordThreads =
+                    parseCountList(nextArgument(argc, argv, i), "--record-threads");
+                for (uint32_t value : options.recordThreads) {
+                    if (value > 64) {
+                        throw std::runtime_error("--record-threads must be between 1 and 64");
+                    }
+                }
+            } else if (arg == "--static") {
+                options.staticCommands = true;
+            } else if (arg == "--warmup") {
+                options.warmupFrames = std::stoull(nextArgument(argc, argv, i));
+            } else if (arg == "--frames") {
+                options.frameCount = std::stoull(nextArgument(argc, argv, i));
+                if (options.frameCount == 0) throw std::runtime_error("--frames must be positive");
+            } else if (arg == "--size") {
+                render::parseSize(nextArgument(argc, argv, i), options.width, options.height);
+            } else if (arg == "--device") {
+                options.deviceSelector = nextArgument(argc, argv, i);
+            } else if (arg == "--sharing") {
+                options.sharingMode = render::parseSharingMode(nextArgument(argc, argv, i));
+            } else if (arg == "--jobs") {
+                options.jobWorkers = render::parseJobWorkers(nextArgument(argc, argv, i));
+            } else if (arg == "--csv") {
+                options.csvPath = nextArgument(argc, argv, i);
+            } else if (arg == "--json") {
+                options.jsonPath = nextArgument(argc, argv, i);
+            } else if (arg == "--baseline") {
+                options.baselinePath = nextArgument(argc, argv, i);
+            } else if (arg == "--tolerance") {
+                options.tolerance = std::stod(nextArgument(argc, argv, i));
+                if (options.tolerance < 0.0) {
+                    throw std::runtime_error("--tolerance must not be negative");
+                }
+            } else if (arg == "--allocations") {
+                options.allocationCycles = std::stoull(nextArgument(argc, argv, i));
+            } else if (arg == "--help") {
+                printUsage(argv[0]);
+                exit(0);
+            } else {
+                throw std::runtime_error("unknown option " + arg);
+            }
+        }
+        for (uint32_t value : options.recordThreads) {
+            render::checkStaticCommands(options.staticCommands, value);
+        }
+    } catch (std::exception& e) {
+        std::cerr << "Error while parsing options : " << e.what() << '\n';
+        printUsage(argv[0]);
+        exit(-1);
+    }
+    return options;
+}
+
+static BenchResult runScene(std::shared_ptr<const render::Device> pDevice,
+                            const BenchOptions& options, const render::SceneParameters& scene,
+                            uint32_t framesInFlight, uint32_t recordThreads) {
+    auto pTarget = std::make_shared<render::OffscreenTarget>(
+        pDevice, vk::Extent2D{options.width, options.height}, framesInFlight);
+    auto pScene = std::make_shared<render::Scene>(pDevice, scene);
+    auto pPacer = std::make_shared<render::FramePacer>(render::PacingPolicy::UNCAPPED, 60.0);
+    // the timer ring has to hold every measured frame
+    render::Renderer renderer(pDevice, pTarget, pScene, pPacer, framesInFlight, recordThreads,
+                              options.staticCommands, options.warmupFrames + options.frameCount);
+    render::FrameTimer& frameTimer = renderer.frameTimer();
+    for (uint64_t i = 0; i < options.warmupFrames + options.frameCount; i++) {
+        frameTimer.beginFrame();
+        renderer.renderFrame();
+        frameTimer.endFrame();
+    }
+    renderer.waitIdle();
+
+    std::vector<render::FrameRecord> records = frameTimer.snapshot(options.warmupFrames);
+    std::vector<double> workSamples, frameSamples, gpuSamples;
+    for (const auto& record : records) {
+        workSamples.push_back(record.cpuWorkTime());
+        frameSamples.push_back(record.frameTime);
+        if (record.gpuTime >= 0.0) gpuSamples.push_back(record.gpuTime);
+    }
+
+    BenchResult result;
+    // inline runs keep their names so older baselines still match
+    result.name = scene.name() + "_f" + std::to_string(framesInFlight);
+    if (options.staticCommands) {
+        result.name += "_s";
+    } else if (recordThreads > 1) {
+        result.name += "_r" + std::to_string(recordThreads);
+    }
+    result.scene = scene;
+    result.framesInFlight = framesInFlight;
+    result.recordThreads = renderer.recordThreads();
+    result.staticCommands = options.staticCommands;
+    result.frames = records.size();
+    result.work = render::FrameTimer::summarize(workSamples);
+    result.frame = render::FrameTimer::summarize(frameSamples);
+    result.gpuResolved = !gpuSamples.empty();
+    result.gpu = render::FrameTimer::summarize(gpuSamples);
+    return result;
+}
+
+// size of the buffers timed by measureAllocations, about a spilled upload chunk
+constexpr VkDeviceSize ALLOCATION_SIZE = 256 << 10;
+// spills alive at once in the streaming pattern, batches complete while newer ones are queued
+constexpr size_t STREAMING_LIVE_BUFFERS = 4;
+
+// Creates and destroys cycles buffers the way the upload spills (freed in creation order while
+// newer ones live) and the readbacks (freed before the next one) do, in their linear pool and
+// with the default heuristics. Returns the mean time per buffer.
+static AllocationResult timeAllocations(const render::Device& device, const char* name,
+                                        render::MemoryPool pool, VkBufferUsageFlags usage,
+                                        VmaAllocationCreateFlags flags, size_t liveBuffers,
+                                        uint64_t cycles) {
+    VkBufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.size = ALLOCATION_SIZE;
+    bufferCreateInfo.usage = usage;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VmaAllocationCreateInfo allocCreateInfo{};
+    allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+    allocCreateInfo.flags = flags;
+    allocCreateInfo.pool = device.memoryPool(pool);
+
+    std::deque<std::pair<VkBuffer, VmaAllocation>> live;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < cycles; i++) {
+        VkBuffer buffer;
+        VmaAllocation allocation;
+        VkResult result = vmaCreateBuffer(device.allocator(), &bufferCreateInfo,
+                                          &allocCreateInfo, &buffer, &allocation, nullptr);
+        if (result != VkResult::VK_SUCCESS) {
+            std::cerr << "Error while timing " << name << " allocations : " << result << '\n';
+            exit(-1);
+        }
+        live.emplace_back(buffer, allocation);
+        if (live.size() >= liveBuffers) {
+            vmaDestroyBuffer(device.allocator(), live.front().first, live.front().second);
+            live.pop_front();
+        }
+    }
+    for (const auto& [buffer, allocation] : live) {
+        vmaDestroyBuffer(device.allocator(), buffer, allocation);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return AllocationResult{name, elapsed.count() / cycles};
+}
+
+static std::vector<AllocationResult> measureAllocations(const render::Device& device,
+                                                        uint64_t cycles) {
+    const VmaAllocationCreateFlags spillFlags =
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    const VmaAllocationCreateFlags readbackFlags =
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    std::vector<AllocationResult> results;
+    for (render::MemoryPool pool : {render::MemoryPool::DEFAULT, render::MemoryPool::STREAMING}) {
+        if (pool != render::MemoryPool::DEFAULT && device.memoryPool(pool) == VK_NULL_HANDLE) {
+            continue;
+        }
+        std::string name = std::string("spill_") + render::memoryPoolName(pool);
+        results.push_back(timeAllocations(device, name.c_str(), pool,
+                                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT, spillFlags,
+                                          STREAMING_LIVE_BUFFERS, cycles));
+    }
+    for (render::MemoryPool pool : {render::MemoryPool::DEFAULT, render::MemoryPool::TRANSIENT}) {
+        if (pool != render::MemoryPool::DEFAULT && device.memoryPool(pool) == VK_NULL_HANDLE) {
+            continue;
+        }
+        std::string name = std::string("readback_") + render::memoryPoolName(pool);
+        results.push_back(timeAllocations(device, name.c_str(), pool,
+                                          VK_BUFFER_USAGE_TRANSFER_DST_BIT, readbackFlags, 1,
+                                          cycles));
+    }
+    return results;
+}
+
+static void writeCsv(std::ostream& os, const std::vector<BenchResult>& results) {
+    os << "run,draws,triangles_per_draw,vertex_format,frames_in_flight,record_threads,static,"
+          "frames";
+    for (const char* metric : {"work", "frame", "gpu"}) {
+        for (const char* statistic : {"mean", "p50", "p90", "p99", "max"}) {
+            os << ',' << metric << '_' << statistic << "_ms";
+        }
+    }
+    os << '\n' << std::setprecision(6);
+    for (const BenchResult& result : results) {
+        os << result.name << ',' << result.scene.drawCount << ',' << result.scene.trianglesPerDraw
+           << ',' << render::vertexFormatName(result.scene.vertexFormat) << ','
+           << result.framesInFlight << ',' << result.recordThreads << ','
+           << result.staticCommands << ',' << result.frames;
+        for (const render::TimingSummary* summary : {&result.work, &result.frame, &result.gpu}) {
+            bool known = summary != &result.gpu || result.gpuResolved;
+            for (double value : {summary->mean, summary->p50, summary->p90, summary->p99,
+                                 summary->max}) {
+                os << ',';
+                if (known) os << value * 1000.0;
+            }
+        }
+        os << '\n';
+    }
+}
+
+static void writeJson(std::ostream& os, const std::string& deviceName,
+                      render::SharingMode sharingMode, const render::JobStats& jobStats,
+                      const std::vector<AllocationResult>& allocations,
+                      const std::vector<BenchResult>& results) {
+    render::JsonWriter writer(os);
+    writer.beginObject();
+    writer.key("device").value(deviceName);
+    writer.key("sharing").value(render::sharingModeName(sharingMode));
+    writer.key("jobs");
+    jobStats.writeJson(writer);
+    if (!allocations.empty()) {
+        writer.key("allocations").beginArray();
+        for (const AllocationResult& allocation : allocations) {
+            writer.beginObject();
+            writer.key("pattern").value(allocation.name);
+            writer.key("ns_per_buffer").value(allocation.nsPerBuffer);
+            writer.endObject();
+        }
+        writer.endArray();
+    }
+    writer.key("runs").beginArray();
+    for (const BenchResult& result : results) {
+        writer.beginObject();
+        writer.key("run").value(result.name);
+        writer.key("draws").value(result.scene.drawCount);
+        writer.key("triangles_per_draw").value(result.scene.trianglesPerDraw);
+        writer.key("vertex_format").value(render::vertexFormatName(result.scene.vertexFormat));
+        writer.key("frames_in_flight").value(result.framesInFlight);
+        writer.key("record_threads").value(result.recordThreads);
+        writer.key("static").value(result.staticCommands);
+        writer.key("frames").value(result.frames);
+        writer.key("work");
+        render::writeTimingSummaryJson(writer, result.work);
+        writer.key("frame");
+        render::writeTimingSummaryJson(writer, result.frame);
+        if (result.gpuResolved) {
+            writer.key("gpu");
+            render::writeTimingSummaryJson(writer, result.gpu);
+        }
+        writer.endObject();
+    }
+    writer.endArray();
+    writer.endObject();
+    os << '\n';
+}
+
+// p50 of the work and gpu times of every run in a CSV written by writeCsv, in milliseconds
+static std::map<std::string, std::pair<double, double>> readBaseline(const std::string& path) {
+    std::ifstream ifs(path);
+    if (!ifs) throw std::runtime_error("cannot open " + path);
+    std::string line;
+    std::getline(ifs, line);
+    std::vector<std::string> header = splitList(line);
+    auto column = [&header](const std::string& name, const std::string& fallback = "") {
+        for (size_t i = 0; i < header.size(); i++) {
+            if (header[i] == name || (!fallback.empty() && header[i] == fallback)) return i;
+        }
+        throw std::runtime_error("baseline has no " + name + " column");
+    };
+    size_t runColumn = column("run");
+    // older baselines named the work time cpu
+    size_t workColumn = column("work_p50_ms", "cpu_p50_ms");
+    size_t gpuColumn = column("gpu_p50_ms");
+
+    std::map<std::string, std::pair<double, double>> baseline;
+    while (std::getline(ifs, line)) {
+        // empty fields are kept, an unknown gpu time is an empty field
+        std::vector<std::string> fields;
+        std::stringstream ss(line);
+        std::string field;
+        while (std::getline(ss, field, ',')) fields.push_back(field);
+        if (fields.size() <= std::max(workColumn, gpuColumn)) continue;
+        double work = std::stod(fields[workColumn]);
+        double gpu = fields[gpuColumn].empty() ? -1.0 : std::stod(fields[gpuColumn]);
+        baseline[fields[runColumn]] = {work, gpu};
+    }
+    return baseline;
+}
+
+// Prints the runs slower than the baseline by more than the tolerance, returns their count
+static size_t checkBaseline(const BenchOptions& options, const std::vector<BenchResult>& results) {
+    std::map<std::string, std::pair<double, double>> baseline;
+    try {
+        baseline = readBaseline(options.baselinePath);
+    } catch (std::exception& e) {
+        std::cerr << "Error while reading baseline " << options.baselinePath << " : " << e.what()
+                  << '\n';
+        exit(-1);
+    }
+    size_t regressions = 0;
+    auto check = [&](const BenchResult& result, const char* metric, double value,
+                     double reference) {
+        if (reference <= 0.0 || value <= reference * (1.0 + options.tolerance)) return;
+        std::cout << "REGRESSION " << result.name << " " << metric << " p50 " << value
+                  << " ms, baseline " << reference << " ms (+"
+                  << 100.0 * (value / reference - 1.0) << "%)\n";
+        regressions++;
+    };
+    for (const BenchResult& result : results) {
+        auto it = baseline.find(result.name);
+        if (it == baseline.end()) {
+            std::cout << "no baseline for " << result.name << '\n';
+            continue;
+        }
+        check(result, "work", result.work.p50 * 1000.0, it->second.first);
+        if (result.gpuResolved) check(result, "gpu", result.gpu.p50 * 1000.0, it->second.second);
+    }
+    return regressions;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options = parseBenchOptions(argc, argv);
+
+    render::DevicePreference devicePreference = render::DevicePreference::fromEnvironment();
+    if (!options.deviceSelector.empty()) devicePreference.selector = options.deviceSelector;
+    devicePreference.sharingMode = options.sharingMode;
+    devicePreference.jobWorkers = options.jobWorkers;
+    auto pInstance = std::make_shared<render::Instance>(true);
+    auto pDevice = std::make_shared<render::Device>(pInstance, devicePreference);
+    std::string deviceName = pDevice->physicalDevice().getProperties().deviceName;
+
+    std::vector<AllocationResult> allocations;
+    if (options.allocationCycles > 0) {
+        allocations = measureAllocations(*pDevice, options.allocationCycles);
+        for (const AllocationResult& allocation : allocations) {
+            std::cout << "ALLOCATIONS " << allocation.name << " : " << allocation.nsPerBuffer
+                      << " ns per buffer\n";
+        }
+    }
+
+    std::vector<BenchResult> results;
+    for (uint32_t framesInFlight : options.framesInFlight) {
+        for (uint32_t recordThreads : options.recordThreads) {
+            for (render::VertexFormat vertexFormat : options.vertexFormats) {
+                for (uint32_t drawCount : options.drawCounts) {
+                    for (uint32_t triangles : options.trianglesPerDraw) {
+                        render::SceneParameters scene;
+                        scene.drawCount = drawCount;
+                        scene.trianglesPerDraw = triangles;
+                        scene.vertexFormat = vertexFormat;
+                        results.push_back(
+                            runScene(pDevice, options, scene, framesInFlight, recordThreads));
+                        const BenchResult& result = results.back();
+                        std::cout << result.name << " : " << result.frames << " frames\n";
+                        render::printTimingSummary(std::cout, "work", result.work);
+                        render::printTimingSummary(std::cout, "frame", result.frame);
+                        if (result.gpuResolved) {
+                            render::printTimingSummary(std::cout, "gpu", result.gpu);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    pDevice->uploadBatcher().stats().print(std::cout);
+    pDevice->jobSystem().stats().print(std::cout);
+
+    if (!options.csvPath.empty()) {
+        std::ofstream ofs(options.csvPath);
+        writeCsv(ofs, results);
+        if (!ofs) std::cerr << "Error while writing " << options.csvPath << '\n';
+    }
+    if (!options.jsonPath.empty()) {
+        std::ofstream ofs(options.jsonPath);
+        writeJson(ofs, deviceName, options.sharingMode, pDevice->jobSystem().stats(), allocations,
+                  results);
+        if (!ofs) std::cerr << "Error while writing " << options.jsonPath << '\n';
+    }
+    if (!options.baselinePath.empty() && checkBaseline(options, results) > 0) {
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
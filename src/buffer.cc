@@ -1,121 +1,245 @@
 #include "buffer.hh"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <iterator>
 #include <vector>
 
+#include "defragmenter.hh"
+#include "trace.hh"
+
 namespace render {
-Buffer::Buffer(const render::Device& device, size_t size, VkBufferUsageFlags usage) : _size(size) {
-    VkBuffer stagingBuffer;
+// tries the custom pool first, a full pool or one whose memory type does not suit the buffer
+// falls back to the default heuristics
+static VkResult createPooledBuffer(const render::Device& device, render::MemoryPool pool,
+                                   const VkBufferCreateInfo& bufferCreateInfo,
+                                   VmaAllocationCreateInfo& allocCreateInfo, VkBuffer& buffer,
+                                   VmaAllocation& allocation, VmaAllocationInfo* allocationInfo) {
+    allocCreateInfo.pool = device.memoryPool(pool);
+    VkResult result = vmaCreateBuffer(device.allocator(), &bufferCreateInfo, &allocCreateInfo,
+                                      &buffer, &allocation, allocationInfo);
+    if (result == VkResult::VK_SUCCESS || allocCreateInfo.pool == VK_NULL_HANDLE) return result;
+    allocCreateInfo.pool = VK_NULL_HANDLE;
+    return vmaCreateBuffer(device.allocator(), &bufferCreateInfo, &allocCreateInfo, &buffer,
+                           &allocation, allocationInfo);
+}
+
+Buffer::Buffer(const render::Device& device, size_t size, VkBufferUsageFlags usage,
+               render::MemoryPool pool)
+    : _size(size),
+      _usage(usage),
+      _deletionQueue(device.deletionQueue()),
+      _moveMutex(device.bufferMoveMutex()) {
+    VkBuffer buffer;
     VkBufferCreateInfo bufferCreateInfo{};
     bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferCreateInfo.size = size;
-    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    std::vector<uint32_t> queueFamilyIndices = {device.transferQueueFamily().index};
-    bufferCreateInfo.pQueueFamilyIndices = queueFamilyIndices.data();
-    bufferCreateInfo.queueFamilyIndexCount = 1;
+    // transfer source for the defragmentation moves
+    bufferCreateInfo.usage =
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | usage;
+    std::vector<uint32_t> queueFamilyIndices;
+    device.fillSharing(bufferCreateInfo, queueFamilyIndices);
 
+    // VMA prefers device local memory which is also host visible and falls back to memory the
+    // host cannot see, the buffer is then only written through transfers
     VmaAllocationCreateInfo allocCreateInfo{};
-    allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
-    allocCreateInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
-
-    auto result = vmaCreateBuffer(device.allocator(), &bufferCreateInfo, &allocCreateInfo,
-                                  &stagingBuffer, &_stagingAllocation, 0);
-    if (result != VkResult::VK_SUCCESS) {
-        std::cerr << "vmaCreateBuffer failed : " << result << "\n";
-        exit(-1);
-    }
-    _stagingBuffer = vk::Buffer(stagingBuffer);
-
-    VkBuffer buffer;
-    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage;
-    bufferCreateInfo.sharingMode =
-        (device.graphicsQueueFamily().index == device.transferQueueFamily().index)
-            ? VK_SHARING_MODE_EXCLUSIVE
-            : VK_SHARING_MODE_CONCURRENT;
-    queueFamilyIndices = {device.graphicsQueueFamily().index,
-                                                device.transferQueueFamily().index};
-    bufferCreateInfo.pQueueFamilyIndices = queueFamilyIndices.data();
-    bufferCreateInfo.queueFamilyIndexCount = 2;
-
     allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
-    allocCreateInfo.flags = 0;
+    allocCreateInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                            VMA_ALLOCATION_CREATE_HOST_ACCESS_ALLOW_TRANSFER_INSTEAD_BIT |
+                            VMA_ALLOCATION_CREATE_MAPPED_BIT;
 
-    result = vmaCreateBuffer(device.allocator(), &bufferCreateInfo, &allocCreateInfo, &buffer,
-                                  &_allocation, 0);
+    VmaAllocationInfo allocationInfo;
+    auto result = createPooledBuffer(device, pool, bufferCreateInfo, allocCreateInfo, buffer,
+                                     _allocation, &allocationInfo);
     if (result != VkResult::VK_SUCCESS) {
         std::cerr << "vmaCreateBuffer failed : " << result << "\n";
         exit(-1);
     }
     _buffer = vk::Buffer(buffer);
     _allocator = device.allocator();
+
+    VkMemoryPropertyFlags memoryProperties;
+    vmaGetAllocationMemoryProperties(_allocator, _allocation, &memoryProperties);
+    _direct = (memoryProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+              allocationInfo.pMappedData != nullptr;
+    if (_direct) _mapped = static_cast<uint8_t*>(allocationInfo.pMappedData);
+    _mappedAllocation = _allocation;
+    // lets the defragmenter find the buffer to move from its allocation
+    vmaSetAllocationUserData(_allocator, _allocation, this);
+    device.uploadBatcher().countBuffer(_direct);
     // we copy the handle of the device's allocator
     // there is no reason for the buffer to outlive the device so it should be safe
 }
 
 Buffer::~Buffer() {
-    vmaDestroyBuffer(_allocator, _stagingBuffer, _stagingAllocation);
-    vmaDestroyBuffer(_allocator, _buffer, _allocation);
+    {
+        std::lock_guard<std::mutex> lock(_moveMutex);
+        // the defragmenter leaves the allocation in place from now on
+        vmaSetAllocationUserData(_allocator, _allocation, nullptr);
+        // the pass in flight destroys the buffer once the GPU is done with both places
+        if (_pMover && _pMover->release(this)) return;
+    }
+    VmaAllocator allocator = _allocator;
+    vk::Buffer buffer = _buffer;
+    VmaAllocation allocation = _allocation;
+    _deletionQueue.push(
+        [allocator, buffer, allocation]() { vmaDestroyBuffer(allocator, buffer, allocation); });
+}
+
+render::UploadToken Buffer::upload(const render::Device& device, const void* data, size_t size,
+                                   size_t offset) {
+    size = std::min(size, _size - std::min(offset, _size));
+    if (!_direct) return device.uploadBatcher().upload(data, size, _buffer, offset);
+    std::memcpy(_mapped + offset, data, size);
+    // no-op on host coherent memory
+    vmaFlushAllocation(_allocator, _mappedAllocation, offset, size);
+    device.uploadBatcher().countDirectWrite(size);
+    return render::UploadToken();
 }
 
 void Buffer::mapData(const render::Device& device, void* data, size_t size) {
-    void* tmp;
-    vmaMapMemory(_allocator, _stagingAllocation, &tmp);
-    std::memcpy(tmp, data, (uint32_t)(std::min(size, _size)));
-    vmaUnmapMemory(_allocator, _stagingAllocation);
-
-    vk::CommandBufferAllocateInfo commandBufferAllocInfo;
-    commandBufferAllocInfo.level = vk::CommandBufferLevel::ePrimary;
-    commandBufferAllocInfo.commandPool = *device.transferCommandPool();
-    commandBufferAllocInfo.commandBufferCount = 1;
-    vk::raii::CommandBuffer commandBuffer = 0;
-    try {
-        commandBuffer =
-            std::move(device.device().allocateCommandBuffers(commandBufferAllocInfo).at(0));
-    } catch (std::exception& e) {
-        std::cerr << "Error while creating temporary command buffer : " << e.what() << '\n';
+    TRACE_SCOPE("Buffer::mapData");
+    device.uploadBatcher().wait(upload(device, data, size));
+}
+
+// updates past the end of a buffer are programming errors
+static void checkRange(size_t offset, size_t size, size_t bufferSize) {
+    if (offset > bufferSize || size > bufferSize - offset) {
+        std::cerr << "Buffer update out of range : " << size << " bytes at " << offset
+                  << " in a buffer of " << bufferSize << " bytes\n";
         exit(-1);
     }
+}
+
+void Buffer::stage(size_t offset, const uint8_t* data, size_t size) {
+    size_t end = offset + size;
+    // first range which ends at or after the write
+    auto it = _staged.upper_bound(offset);
+    if (it != _staged.begin()) {
+        auto previous = std::prev(it);
+        if (previous->first + previous->second.size() >= offset) it = previous;
+    }
+    if (it == _staged.end() || it->first > end) {
+        _staged.emplace_hint(it, offset, std::vector<uint8_t>(data, data + size));
+        return;
+    }
+    // the write is merged into the first range it touches, growing it at the end is amortized
+    // so a sequence of consecutive writes stays linear
+    size_t start = std::min(offset, it->first);
+    std::vector<uint8_t> merged = std::move(it->second);
+    if (it->first > offset) merged.insert(merged.begin(), it->first - offset, 0);
+    it = _staged.erase(it);
+    for (; it != _staged.end() && it->first <= end; it = _staged.erase(it)) {
+        merged.resize(std::max(merged.size(), it->first + it->second.size() - start));
+        std::memcpy(merged.data() + it->first - start, it->second.data(), it->second.size());
+    }
+    merged.resize(std::max(merged.size(), end - start));
+    std::memcpy(merged.data() + offset - start, data, size);
+    _staged.emplace_hint(it, start, std::move(merged));
+}
 
-    vk::CommandBufferBeginInfo beginInfo;
-    beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+void Buffer::update(size_t offset, const void* data, size_t size) {
+    checkRange(offset, size, _size);
+    if (size == 0) return;
+    if (_direct) {
+        std::memcpy(_mapped + offset, data, size);
+        _dirtyRanges.add(offset, size);
+    } else {
+        stage(offset, static_cast<const uint8_t*>(data), size);
+    }
+}
 
-    commandBuffer.begin(beginInfo);
-    {
-        vk::BufferCopy copyRegion;
-        copyRegion.srcOffset = 0;
-        copyRegion.dstOffset = 0;
-        copyRegion.size = _size;
-        commandBuffer.copyBuffer(_stagingBuffer, _buffer, {copyRegion});
+render::UploadToken Buffer::flush(const render::Device& device) {
+    render::UploadToken token;
+    if (_dirtyRanges.empty() && _staged.empty()) return token;
+    TRACE_SCOPE("Buffer::flush");
+    if (_direct) {
+        size_t bytes = _dirtyRanges.bytes();
+        std::vector<render::ByteRange> ranges = _dirtyRanges.take();
+        std::vector<VmaAllocation> allocations(ranges.size(), _mappedAllocation);
+        std::vector<VkDeviceSize> offsets, sizes;
+        for (const auto& range : ranges) {
+            offsets.push_back(range.offset);
+            sizes.push_back(range.size);
+        }
+        vmaFlushAllocations(_allocator, (uint32_t)ranges.size(), allocations.data(),
+                            offsets.data(), sizes.data());
+        device.uploadBatcher().countDirectWrite(bytes);
+        return token;
     }
-    commandBuffer.end();
+    for (const auto& [offset, bytes] : _staged) {
+        token.merge(device.uploadBatcher().upload(bytes.data(), bytes.size(), _buffer, offset));
+    }
+    // the batcher copied the bytes into staging
+    _staged.clear();
+    return token;
+}
 
-    vk::SubmitInfo submitInfo;
-    submitInfo.setCommandBuffers(*commandBuffer);
+vk::Buffer Buffer::beginMove(const render::Device& device, VmaAllocation destination,
+                             render::UploadToken& token, render::Defragmenter* pMover) {
+    VkBuffer buffer;
+    VkBufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.size = _size;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                             _usage;
+    std::vector<uint32_t> queueFamilyIndices;
+    device.fillSharing(bufferCreateInfo, queueFamilyIndices);
+    VkResult result = vmaCreateAliasingBuffer(_allocator, destination, &bufferCreateInfo, &buffer);
+    if (result != VkResult::VK_SUCCESS) {
+        std::cerr << "Error while moving a buffer : " << result << "\n";
+        exit(-1);
+    }
 
-    device.transferQueue().submit(submitInfo, nullptr);
-    device.transferQueue().waitIdle();
+    vk::Buffer oldBuffer = _buffer;
+    if (_direct) {
+        // the host may write the new mapping as soon as the handles are swapped, a GPU copy
+        // would land after those writes
+        VmaAllocationInfo destinationInfo;
+        vmaGetAllocationInfo(_allocator, destination, &destinationInfo);
+        vmaInvalidateAllocation(_allocator, _mappedAllocation, 0, _size);
+        std::memcpy(destinationInfo.pMappedData, _mapped, _size);
+        vmaFlushAllocation(_allocator, destination, 0, _size);
+        _mapped = static_cast<uint8_t*>(destinationInfo.pMappedData);
+        _mappedAllocation = destination;
+    } else {
+        token.merge(device.uploadBatcher().move(oldBuffer, vk::Buffer(buffer), _size));
+    }
+    _buffer = vk::Buffer(buffer);
+    _generation++;
+    _pMover = pMover;
+    return oldBuffer;
 }
 
-HostBuffer::HostBuffer(const render::Device& device, size_t size, VkBufferUsageFlags usage) : _size(size) {
+void Buffer::endMove() {
+    _pMover = nullptr;
+    // the allocation now refers to the memory the content was moved to
+    _mappedAllocation = _allocation;
+    if (_direct) {
+        VmaAllocationInfo allocationInfo;
+        vmaGetAllocationInfo(_allocator, _allocation, &allocationInfo);
+        _mapped = static_cast<uint8_t*>(allocationInfo.pMappedData);
+    }
+}
+
+HostBuffer::HostBuffer(const render::Device& device, size_t size, VkBufferUsageFlags usage,
+                       render::MemoryPool pool)
+    : _size(size), _deletionQueue(device.deletionQueue()) {
     VkBuffer buffer;
     VkBufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.size = size;
     bufferCreateInfo.usage = usage;
-    bufferCreateInfo.sharingMode =
-        (device.graphicsQueueFamily().index == device.transferQueueFamily().index)
-            ? VK_SHARING_MODE_EXCLUSIVE
-            : VK_SHARING_MODE_CONCURRENT;
-    std::vector<uint32_t> queueFamilyIndices = {device.graphicsQueueFamily().index,
-                                                device.transferQueueFamily().index};
-    bufferCreateInfo.pQueueFamilyIndices = queueFamilyIndices.data();
-    bufferCreateInfo.queueFamilyIndexCount = 2;
+    std::vector<uint32_t> queueFamilyIndices;
+    device.fillSharing(bufferCreateInfo, queueFamilyIndices);
 
     VmaAllocationCreateInfo allocCreateInfo{};
     allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
     allocCreateInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;;
 
-    VkResult result = vmaCreateBuffer(device.allocator(), &bufferCreateInfo, &allocCreateInfo, &buffer,
-                                  &_allocation, 0);
+    VkResult result = createPooledBuffer(device, pool, bufferCreateInfo, allocCreateInfo, buffer,
+                                         _allocation, nullptr);
     if (result != VkResult::VK_SUCCESS) {
         std::cerr << "vmaCreateBuffer failed : " << result << "\n";
         exit(-1);
@@ -128,12 +252,21 @@ HostBuffer::HostBuffer(const render::Device& device, size_t size, VkBufferUsageF
 }
 
 HostBuffer::~HostBuffer() {
-    vmaUnmapMemory(_allocator, _allocation);
-    _mapBinding = nullptr;
-    vmaDestroyBuffer(_allocator, _buffer, _allocation);
+    VmaAllocator allocator = _allocator;
+    vk::Buffer buffer = _buffer;
+    VmaAllocation allocation = _allocation;
+    _deletionQueue.push([allocator, buffer, allocation]() {
+        vmaUnmapMemory(allocator, allocation);
+        vmaDestroyBuffer(allocator, buffer, allocation);
+    });
 }
 
 void HostBuffer::mapData(const render::Device& device, void* data, size_t size) {
+    TRACE_SCOPE("HostBuffer::mapData");
     std::memcpy(_mapBinding, data, (uint32_t)(std::min(size, _size)));
 }
+
+void HostBuffer::flush(size_t offset, size_t size) const {
+    vmaFlushAllocation(_allocator, _allocation, offset, size);
+}
 } // namespace render
\ No newline at end of file
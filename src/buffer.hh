@@ -1,30 +1,84 @@
 #pragma once
 
 #include <vulkan/vulkan_raii.hpp>
+#include <map>
+#include <mutex>
+#include <vector>
 
 #include "instance.hh"
 #include "device.hh"
+#include "dirty_ranges.hh"
 
 #include "vk_mem_alloc.h"
 
 namespace render {
+class Defragmenter;
+
+// Device local buffer. When the memory VMA picked is also host visible (integrated GPUs, CPU
+// implementations, resizable BAR) writes go straight to the mapped buffer, otherwise they are
+// staged and copied by the device upload batcher.
+// The defragmenter may move the buffer to another allocation, its handle then changes and its
+// generation is incremented, users must not keep the handle across frames. A buffer can be
+// destroyed at any time, even while it is being moved.
 class Buffer {
 private:
     size_t _size;
-    vk::Buffer _stagingBuffer;
-    VmaAllocation _stagingAllocation;
+    VkBufferUsageFlags _usage;
+    bool _direct = false;
+    uint8_t* _mapped = nullptr; // only set for direct buffers
+    VmaAllocation _mappedAllocation = VK_NULL_HANDLE; // memory _mapped points to
+    uint64_t _generation = 0;
+    // staged buffers keep the bytes written by update until they are flushed, one entry per
+    // range written since the previous flush, overlapping and adjacent writes are merged
+    std::map<size_t, std::vector<uint8_t>> _staged; // offset to bytes
+    render::DirtyRanges _dirtyRanges; // only for direct buffers
     vk::Buffer _buffer;
     VmaAllocation _allocation;
     VmaAllocator _allocator;
+    render::DeletionQueue& _deletionQueue;
+    std::mutex& _moveMutex;
+    render::Defragmenter* _pMover = nullptr; // set between beginMove and endMove
+
+    void stage(size_t offset, const uint8_t* data, size_t size);
 
 public:
-    Buffer(const render::Device& device, size_t size, VkBufferUsageFlags usage);
+    // Allocated from pool when it has room, else with the default VMA heuristics
+    Buffer(const render::Device& device, size_t size, VkBufferUsageFlags usage,
+           render::MemoryPool pool = render::MemoryPool::DEFAULT);
+    // Destroyed once the frames and uploads which may use it have completed
     ~Buffer();
+    // Writes directly or queues the write on the device upload batcher, the range must not be
+    // read before the token has completed. A direct write is complete on return, the caller
+    // must not overwrite data the GPU may still be reading.
+    render::UploadToken upload(const render::Device& device, const void* data, size_t size,
+                               size_t offset = 0);
+    // Uploads and waits for the copy to complete
     void mapData(const render::Device& device, void* data, size_t size);
+    // Writes part of the buffer. A direct buffer is written in place, the device may only see
+    // the bytes once flushed. A staged buffer keeps them on the host until the next flush.
+    void update(size_t offset, const void* data, size_t size);
+    // Sends the bytes changed since the previous flush, merged in as few ranges as possible
+    render::UploadToken flush(const render::Device& device);
+
+    // Defragmentation moves, see Defragmenter, both called with the device buffer move mutex
+    // held. beginMove binds a new buffer to destination, queues the copy of the content and
+    // swaps the handles. The returned old buffer must be destroyed once the GPU is done with
+    // it, before endMove is called at the end of the pass. A buffer destroyed in between hands
+    // both handles and its allocation over to the mover.
+    vk::Buffer beginMove(const render::Device& device, VmaAllocation destination,
+                         render::UploadToken& token, render::Defragmenter* pMover);
+    void endMove();
 
     const vk::Buffer& buffer() const {
         return _buffer;
     }
+    bool direct() const {
+        return _direct;
+    }
+    // Incremented every time the buffer is moved
+    uint64_t generation() const {
+        return _generation;
+    }
 };
 
 class HostBuffer {
@@ -34,14 +88,26 @@ private:
     VmaAllocation _allocation;
     void *_mapBinding;
     VmaAllocator _allocator;
+    render::DeletionQueue& _deletionQueue;
 
 public:
-    HostBuffer(const render::Device& device, size_t size, VkBufferUsageFlags usage);
+    HostBuffer(const render::Device& device, size_t size, VkBufferUsageFlags usage,
+               render::MemoryPool pool = render::MemoryPool::DEFAULT);
+    // Destroyed once the frames which may use it have completed
     ~HostBuffer();
     void mapData(const render::Device& device, void* data, size_t size);
+    // Makes host writes to the range visible to the device, no-op on host coherent memory
+    void flush(size_t offset, size_t size) const;
 
     const vk::Buffer& buffer() const {
         return _buffer;
     }
+    // Persistently mapped for the lifetime of the buffer
+    void* mapped() const {
+        return _mapBinding;
+    }
+    size_t size() const {
+        return _size;
+    }
 };
 } // namespace render
\ No newline at end of file
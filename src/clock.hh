@@ -0,0 +1,13 @@
+#pragma once
+
+#include <chrono>
+#include <time.h>
+
+namespace render {
+// CPU time consumed by the calling thread, blocking waits do not count
+inline std::chrono::nanoseconds threadCpuTime() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+} // namespace render
\ No newline at end of file
@@ -0,0 +1,267 @@
+#include "defragmenter.hh"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+
+#include "trace.hh"
+
+namespace render {
+// frames between two fragmentation checks, measuring walks every block
+constexpr uint64_t DEFRAGMENT_CHECK_INTERVAL = 600;
+// a run starts above this fragmentation when enough memory is free to be worth it
+constexpr double DEFRAGMENT_THRESHOLD = 0.25;
+constexpr vk::DeviceSize DEFRAGMENT_MIN_FREE_BYTES = 4ull << 20;
+
+double FragmentationMetrics::fragmentation() const {
+    vk::DeviceSize freeBytes = blockBytes - allocationBytes;
+    if (freeBytes == 0) return 0.0;
+    return 1.0 - (double)largestFreeRange / freeBytes;
+}
+
+void FragmentationMetrics::print(std::ostream& os) const {
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(1) << blockCount << " blocks, "
+       << blockBytes / (1024.0 * 1024.0) << " MiB, "
+       << (blockBytes - allocationBytes) / (1024.0 * 1024.0) << " MiB free in " << freeRangeCount
+       << " ranges, fragmentation " << 100.0 * fragmentation() << "%";
+    os.flags(flags);
+    os.precision(precision);
+}
+
+void FragmentationMetrics::writeJson(JsonWriter& writer) const {
+    writer.beginObject();
+    writer.key("blocks").value(blockCount);
+    writer.key("block_bytes").value((uint64_t)blockBytes);
+    writer.key("allocation_bytes").value((uint64_t)allocationBytes);
+    writer.key("free_ranges").value(freeRangeCount);
+    writer.key("largest_free_range").value((uint64_t)largestFreeRange);
+    writer.key("fragmentation").value(fragmentation());
+    writer.endObject();
+}
+
+Defragmenter::Defragmenter(std::shared_ptr<const render::Device> pDevice,
+                           vk::DeviceSize maxBytesPerPass, uint32_t maxMovesPerPass)
+    : _pDevice(pDevice),
+      _maxBytesPerPass(maxBytesPerPass),
+      _maxMovesPerPass(maxMovesPerPass),
+      // moved ranges would need their ownership transferred as well
+      _enabled(!pDevice->ownershipTransfers()) {
+}
+
+Defragmenter::~Defragmenter() {
+    finish();
+}
+
+FragmentationMetrics Defragmenter::measure() const {
+    VmaTotalStatistics statistics;
+    vmaCalculateStatistics(_pDevice->allocator(), &statistics);
+    const VmaDetailedStatistics& total = statistics.total;
+    FragmentationMetrics metrics;
+    metrics.blockCount = total.statistics.blockCount;
+    metrics.blockBytes = total.statistics.blockBytes;
+    metrics.allocationBytes = total.statistics.allocationBytes;
+    metrics.freeRangeCount = total.unusedRangeCount;
+    metrics.largestFreeRange = total.unusedRangeCount ? total.unusedRangeSizeMax : 0;
+    return metrics;
+}
+
+void Defragmenter::start() {
+    if (!_enabled || active()) return;
+    _stats.before = measure();
+    _stats.runs++;
+    _targets.clear();
+    // popped from the back, the default pools go last
+    _targets.push_back(VK_NULL_HANDLE);
+    VmaPool geometryPool = _pDevice->memoryPool(MemoryPool::GEOMETRY);
+    if (geometryPool != VK_NULL_HANDLE) _targets.push_back(geometryPool);
+    beginContext();
+}
+
+void Defragmenter::beginContext() {
+    while (!_targets.empty()) {
+        VmaDefragmentationInfo defragmentationInfo{};
+        defragmentationInfo.pool = _targets.back();
+        defragmentationInfo.maxBytesPerPass = _maxBytesPerPass;
+        defragmentationInfo.maxAllocationsPerPass = _maxMovesPerPass;
+        _targets.pop_back();
+        if (vmaBeginDefragmentation(_pDevice->allocator(), &defragmentationInfo, &_context) ==
+            VkResult::VK_SUCCESS) {
+            return;
+        }
+        _context = VK_NULL_HANDLE;
+    }
+    _stats.after = measure();
+}
+
+void Defragmenter::endContext() {
+    VmaDefragmentationStats defragmentationStats;
+    vmaEndDefragmentation(_pDevice->allocator(), _context, &defragmentationStats);
+    _context = VK_NULL_HANDLE;
+    _stats.bytesMoved += defragmentationStats.bytesMoved;
+    _stats.bytesFreed += defragmentationStats.bytesFreed;
+    _stats.blocksFreed += defragmentationStats.deviceMemoryBlocksFreed;
+    beginContext();
+}
+
+void Defragmenter::beginPass() {
+    TRACE_SCOPE("Defragmenter::beginPass");
+    VmaAllocator allocator = _pDevice->allocator();
+    // writes queued to the buffers before they move go out in earlier batches
+    _pDevice->uploadBatcher().flush();
+    // buffers are not destroyed while their moves start
+    std::lock_guard<std::mutex> lock(_pDevice->bufferMoveMutex());
+    _passToken = render::UploadToken();
+    if (vmaBeginDefragmentationPass(allocator, _context, &_pass) == VkResult::VK_SUCCESS) {
+        endContext(); // nothing left to move
+        return;
+    }
+    for (uint32_t i = 0; i < _pass.moveCount; i++) {
+        VmaDefragmentationMove& move = _pass.pMoves[i];
+        VmaAllocationInfo allocationInfo;
+        vmaGetAllocationInfo(allocator, move.srcAllocation, &allocationInfo);
+        render::Buffer* pBuffer = static_cast<render::Buffer*>(allocationInfo.pUserData);
+        if (pBuffer == nullptr) {
+            move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            _stats.ignoredMoves++;
+            continue;
+        }
+        vk::Buffer oldBuffer =
+            pBuffer->beginMove(*_pDevice, move.dstTmpAllocation, _passToken, this);
+        _moved.push_back(MovedBuffer{pBuffer, oldBuffer, vk::Buffer(), i});
+    }
+    _stats.passes++;
+    _stats.moves += _moved.size();
+    _passOpen = true;
+    // the frames recorded from now on use the new buffers
+    _passGraphicsValue = _pDevice->graphicsTimeline().submitted();
+}
+
+std::pair<uint64_t, render::UploadToken> Defragmenter::passValues() const {
+    std::lock_guard<std::mutex> lock(_pDevice->bufferMoveMutex());
+    return {_passGraphicsValue, _passToken};
+}
+
+bool Defragmenter::endPass(uint64_t passGraphicsValue, render::UploadToken passToken) {
+    TRACE_SCOPE("Defragmenter::endPass");
+    VmaAllocator allocator = _pDevice->allocator();
+    std::lock_guard<std::mutex> lock(_pDevice->bufferMoveMutex());
+    if (_passGraphicsValue != passGraphicsValue || _passToken.value != passToken.value) {
+        return false;
+    }
+    // the allocations of the abandoned moves are freed by VMA along with their destinations
+    for (const MovedBuffer& moved : _moved) {
+        vmaDestroyBuffer(allocator, moved.oldBuffer, VK_NULL_HANDLE);
+        if (!moved.pBuffer) vmaDestroyBuffer(allocator, moved.newBuffer, VK_NULL_HANDLE);
+    }
+    VkResult result = vmaEndDefragmentationPass(allocator, _context, &_pass);
+    for (const MovedBuffer& moved : _moved) {
+        if (moved.pBuffer) moved.pBuffer->endMove();
+    }
+    // a pass where every move was ignored would be offered again
+    bool moved = !_moved.empty();
+    _moved.clear();
+    _passOpen = false;
+    if (result != VkResult::VK_INCOMPLETE || !moved) endContext();
+    return true;
+}
+
+render::UploadToken Defragmenter::step(uint64_t frameNumber) {
+    if (!_enabled) return render::UploadToken();
+    if (!active()) {
+        if (frameNumber == 0 || frameNumber % DEFRAGMENT_CHECK_INTERVAL != 0) {
+            return render::UploadToken();
+        }
+        FragmentationMetrics metrics = measure();
+        if (metrics.fragmentation() < DEFRAGMENT_THRESHOLD ||
+            metrics.blockBytes - metrics.allocationBytes < DEFRAGMENT_MIN_FREE_BYTES) {
+            return render::UploadToken();
+        }
+        start();
+    }
+    if (_passOpen) {
+        auto [passGraphicsValue, passToken] = passValues();
+        if (!_pDevice->graphicsTimeline().reached(passGraphicsValue) ||
+            !_pDevice->uploadBatcher().completed(passToken) ||
+            !endPass(passGraphicsValue, passToken)) {
+            return render::UploadToken();
+        }
+    }
+    if (!active()) return render::UploadToken();
+    beginPass();
+    return _passToken;
+}
+
+void Defragmenter::finish() {
+    if (!active()) return;
+    while (_passOpen) {
+        auto [passGraphicsValue, passToken] = passValues();
+        // no frame is recorded while finishing, a release counting the next one must not make
+        // us wait for a submission which never comes
+        const render::Timeline& graphicsTimeline = _pDevice->graphicsTimeline();
+        graphicsTimeline.wait(std::min(passGraphicsValue, graphicsTimeline.submitted()));
+        _pDevice->uploadBatcher().wait(passToken);
+        endPass(passGraphicsValue, passToken);
+    }
+    _targets.clear();
+    if (active()) endContext();
+}
+
+bool Defragmenter::release(render::Buffer* pBuffer) {
+    for (MovedBuffer& moved : _moved) {
+        if (moved.pBuffer != pBuffer) continue;
+        _pass.pMoves[moved.moveIndex].operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY;
+        moved.newBuffer = pBuffer->buffer();
+        moved.pBuffer = nullptr;
+        // the frame being recorded and the writes queued so far may still use the new place
+        _passGraphicsValue =
+            std::max(_passGraphicsValue, _pDevice->graphicsTimeline().submitted() + 1);
+        _passToken.merge(_pDevice->uploadBatcher().pendingToken());
+        _stats.abandonedMoves++;
+        return true;
+    }
+    return false;
+}
+
+void Defragmenter::printStats(std::ostream& os) const {
+    if (_stats.runs == 0) return;
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(1);
+    os << "DEFRAGMENTATION : " << _stats.runs << " runs, " << _stats.passes << " passes, "
+       << _stats.moves << " moves (" << _stats.ignoredMoves << " ignored, "
+       << _stats.abandonedMoves << " abandoned), "
+       << _stats.bytesMoved / (1024.0 * 1024.0) << " MiB moved, "
+       << _stats.bytesFreed / (1024.0 * 1024.0) << " MiB in " << _stats.blocksFreed
+       << " blocks freed\n";
+    os << "  before : ";
+    _stats.before.print(os);
+    os << "\n  after  : ";
+    _stats.after.print(os);
+    os << '\n';
+    os.flags(flags);
+    os.precision(precision);
+}
+
+void Defragmenter::writeJson(JsonWriter& writer) const {
+    writer.beginObject();
+    writer.key("enabled").value(_enabled);
+    writer.key("runs").value(_stats.runs);
+    writer.key("passes").value(_stats.passes);
+    writer.key("moves").value(_stats.moves);
+    writer.key("ignored_moves").value(_stats.ignoredMoves);
+    writer.key("abandoned_moves").value(_stats.abandonedMoves);
+    writer.key("bytes_moved").value(_stats.bytesMoved);
+    writer.key("bytes_freed").value(_stats.bytesFreed);
+    writer.key("blocks_freed").value(_stats.blocksFreed);
+    writer.key("before");
+    _stats.before.writeJson(writer);
+    writer.key("after");
+    _stats.after.writeJson(writer);
+    writer.key("current");
+    measure().writeJson(writer);
+    writer.endObject();
+}
+} // namespace render
\ No newline at end of file
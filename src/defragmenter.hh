@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "device.hh"
+#include "buffer.hh"
+#include "json_writer.hh"
+
+#include "vk_mem_alloc.h"
+
+namespace render {
+struct FragmentationMetrics {
+    uint32_t blockCount = 0;
+    vk::DeviceSize blockBytes = 0;
+    vk::DeviceSize allocationBytes = 0;
+    uint32_t freeRangeCount = 0;
+    vk::DeviceSize largestFreeRange = 0;
+
+    // share of the free bytes outside of the largest free range
+    double fragmentation() const;
+    void print(std::ostream& os) const;
+    void writeJson(JsonWriter& writer) const;
+};
+
+struct DefragmentationStats {
+    uint64_t runs = 0;
+    uint64_t passes = 0;
+    uint64_t moves = 0;
+    uint64_t ignoredMoves = 0; // allocations which are not a Buffer, they stay in place
+    uint64_t abandonedMoves = 0; // buffers destroyed while they were being moved
+    uint64_t bytesMoved = 0;
+    uint64_t bytesFreed = 0;
+    uint64_t blocksFreed = 0;
+    // around the last completed run
+    FragmentationMetrics before;
+    FragmentationMetrics after;
+};
+
+// Incremental VMA defragmentation of the geometry pool and of the default pools. A run starts
+// when the memory is fragmented enough, then at most one pass is in flight: its moves are
+// copied by the upload batcher, the moved buffers switch to their new handles for the frames
+// recorded afterwards, and the pass ends once the GPU no longer uses the old ones.
+// A buffer destroyed while it is being moved is handed over to the pass, which abandons its move
+// and destroys it once the GPU no longer uses either place.
+class Defragmenter {
+private:
+    struct MovedBuffer {
+        render::Buffer* pBuffer; // null once the buffer was destroyed during the pass
+        vk::Buffer oldBuffer;    // the handle it left
+        vk::Buffer newBuffer;    // only kept for destroyed buffers
+        uint32_t moveIndex;      // in the moves of the pass
+    };
+
+    std::shared_ptr<const render::Device> _pDevice;
+    vk::DeviceSize _maxBytesPerPass;
+    uint32_t _maxMovesPerPass;
+    bool _enabled;
+    std::vector<VmaPool> _targets; // pools left in the run, null for the default pools
+    VmaDefragmentationContext _context = VK_NULL_HANDLE;
+    VmaDefragmentationPassMoveInfo _pass{};
+    bool _passOpen = false;
+    // last graphics submission which may use the old buffers, or a buffer destroyed during the
+    // pass. Written under the device buffer move mutex, as _passToken and _moved.
+    uint64_t _passGraphicsValue = 0;
+    render::UploadToken _passToken;
+    std::vector<MovedBuffer> _moved;
+    DefragmentationStats _stats;
+
+    void beginContext();
+    void endContext();
+    void beginPass();
+    // False, leaving the pass open, when a buffer destroyed since the caller read the values it
+    // waited for pushed them further
+    bool endPass(uint64_t passGraphicsValue, render::UploadToken passToken);
+    // The values the pass has to wait for, read under the device buffer move mutex
+    std::pair<uint64_t, render::UploadToken> passValues() const;
+
+public:
+    Defragmenter(std::shared_ptr<const render::Device> pDevice,
+                 vk::DeviceSize maxBytesPerPass = 8ull << 20, uint32_t maxMovesPerPass = 64);
+    ~Defragmenter();
+    Defragmenter(const Defragmenter&) = delete;
+    Defragmenter& operator=(const Defragmenter&) = delete;
+
+    FragmentationMetrics measure() const;
+    // Starts a run unless one is active
+    void start();
+    bool active() const {
+        return _context != VK_NULL_HANDLE;
+    }
+    // Called once per frame before recording. Ends the pass in flight once the frames which may
+    // read the old buffers have completed and begins the next one, the frames must wait on the
+    // returned token before reading the moved buffers.
+    render::UploadToken step(uint64_t frameNumber);
+    // Waits for the GPU to be done with the pass in flight and ends the active run
+    void finish();
+    // Called by a buffer being destroyed between beginMove and endMove, with the device buffer
+    // move mutex held. False when the pass has already ended, the buffer then goes through the
+    // deletion queue as usual.
+    bool release(render::Buffer* pBuffer);
+
+    const DefragmentationStats& stats() const {
+        return _stats;
+    }
+    void printStats(std::ostream& os) const;
+    void writeJson(JsonWriter& writer) const;
+};
+} // namespace render
\ No newline at end of file
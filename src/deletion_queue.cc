@@ -0,0 +1,79 @@
+#include "deletion_queue.hh"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "trace.hh"
+
+namespace render {
+void DeletionStats::print(std::ostream& os) const {
+    os << "DELETIONS : " << deferred << " deferred, " << destroyed << " destroyed, at most "
+       << maxPending << " pending\n";
+}
+
+void DeletionStats::writeJson(JsonWriter& writer) const {
+    writer.beginObject();
+    writer.key("deferred").value(deferred);
+    writer.key("destroyed").value(destroyed);
+    writer.key("max_pending").value(maxPending);
+    writer.endObject();
+}
+
+DeletionQueue::DeletionQueue(const render::Timeline& graphicsTimeline,
+                             const render::UploadBatcher& uploadBatcher)
+    : _graphicsTimeline(graphicsTimeline), _uploadBatcher(uploadBatcher) {
+}
+
+DeletionQueue::~DeletionQueue() {
+    flush();
+}
+
+void DeletionQueue::push(std::function<void()> destroy) {
+    // read under the lock so the deleters stay in the order of their values, retire stops at
+    // the first one not reached
+    std::lock_guard<std::mutex> lock(_mutex);
+    // copies queued to the resource may still be waiting for their batch to be flushed
+    render::UploadToken upload = _uploadBatcher.pendingToken();
+    uint64_t graphicsValue = _graphicsTimeline.submitted() + 1;
+    _deleters.push_back(Deleter{graphicsValue, upload, std::move(destroy)});
+    _stats.deferred++;
+    _stats.maxPending = std::max<uint64_t>(_stats.maxPending, _deleters.size());
+}
+
+void DeletionQueue::retire() {
+    uint64_t graphicsValue = _graphicsTimeline.completed();
+    std::vector<std::function<void()>> ready;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        while (!_deleters.empty() && _deleters.front().graphicsValue <= graphicsValue &&
+               _uploadBatcher.completed(_deleters.front().upload)) {
+            ready.push_back(std::move(_deleters.front().destroy));
+            _deleters.pop_front();
+        }
+        _stats.destroyed += ready.size();
+    }
+    if (ready.empty()) return;
+    TRACE_SCOPE("DeletionQueue::retire");
+    // outside of the lock, a deleter may release other resources
+    for (auto& destroy : ready) destroy();
+}
+
+void DeletionQueue::flush() {
+    while (true) {
+        std::deque<Deleter> deleters;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            deleters.swap(_deleters);
+            _stats.destroyed += deleters.size();
+        }
+        if (deleters.empty()) return;
+        for (Deleter& deleter : deleters) deleter.destroy();
+    }
+}
+
+DeletionStats DeletionQueue::stats() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+} // namespace render
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <ostream>
+
+#include "timeline.hh"
+#include "upload_batcher.hh"
+#include "json_writer.hh"
+
+namespace render {
+struct DeletionStats {
+    uint64_t deferred = 0;
+    uint64_t destroyed = 0;
+    uint64_t maxPending = 0;
+
+    void print(std::ostream& os) const;
+    void writeJson(JsonWriter& writer) const;
+};
+
+// Resources released while the GPU may still use them. Each deleter is tagged with the next
+// value of the graphics timeline, the submission of the frame being recorded, and with the
+// pending upload batch. It runs once both are reached, so releasing never waits for the GPU.
+// Deleters can be pushed from any thread.
+class DeletionQueue {
+private:
+    struct Deleter {
+        uint64_t graphicsValue;
+        render::UploadToken upload;
+        std::function<void()> destroy;
+    };
+
+    const render::Timeline& _graphicsTimeline;
+    const render::UploadBatcher& _uploadBatcher;
+    mutable std::mutex _mutex;
+    std::deque<Deleter> _deleters; // in release order
+    DeletionStats _stats;
+
+public:
+    DeletionQueue(const render::Timeline& graphicsTimeline,
+                  const render::UploadBatcher& uploadBatcher);
+    ~DeletionQueue();
+    DeletionQueue(const DeletionQueue&) = delete;
+    DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+    void push(std::function<void()> destroy);
+    // Runs the deleters whose values have been reached, cheap enough to call every frame
+    void retire();
+    // Runs every deleter, the device must be idle
+    void flush();
+
+    DeletionStats stats() const;
+};
+} // namespace render
\ No newline at end of file
@@ -1,51 +1,206 @@
 #include "device.hh"
 
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iomanip>
 #include <iostream>
+#include <mutex>
+#include <stdexcept>
 #include <set>
+#include <sstream>
 
 #define VMA_IMPLEMENTATION
 #include "vk_mem_alloc.h"
 
+#include "trace.hh"
+
 namespace render {
 
-void Device::selectPhysicalDevice(const vk::raii::SurfaceKHR& surface) {
+DevicePreference DevicePreference::fromEnvironment() {
+    DevicePreference preference;
+    const char* selector = std::getenv("PAIN_BAGNAT_DEVICE");
+    if (selector) preference.selector = selector;
+    return preference;
+}
+
+SharingMode parseSharingMode(const std::string& name) {
+    if (name == "concurrent") return SharingMode::CONCURRENT;
+    if (name == "exclusive") return SharingMode::EXCLUSIVE;
+    throw std::runtime_error("unknown sharing mode " + name);
+}
+
+const char* sharingModeName(SharingMode mode) {
+    switch (mode) {
+        case SharingMode::CONCURRENT:
+            return "concurrent";
+        case SharingMode::EXCLUSIVE:
+            return "exclusive";
+    }
+    return "unknown";
+}
+
+const char* memoryPoolName(MemoryPool pool) {
+    switch (pool) {
+        case MemoryPool::DEFAULT:
+            return "default";
+        case MemoryPool::TRANSIENT:
+            return "transient";
+        case MemoryPool::STREAMING:
+            return "streaming";
+        case MemoryPool::GEOMETRY:
+            return "geometry";
+        case MemoryPool::COUNT:
+            break;
+    }
+    return "unknown";
+}
+
+static std::string physicalDeviceUuid(const vk::raii::PhysicalDevice& physicalDevice) {
+    auto props = physicalDevice.getProperties2<vk::PhysicalDeviceProperties2,
+                                               vk::PhysicalDeviceIDProperties>();
+    const auto& uuid = props.get<vk::PhysicalDeviceIDProperties>().deviceUUID;
+    std::ostringstream os;
+    os << std::hex << std::setfill('0');
+    for (size_t i = 0; i < uuid.size(); i++) {
+        if (i == 4 || i == 6 || i == 8 || i == 10) os << '-';
+        os << std::setw(2) << (int)uuid[i];
+    }
+    return os.str();
+}
+
+static std::string toLower(std::string str) {
+    std::transform(str.begin(), str.end(), str.begin(),
+                   [](unsigned char c) { return (char)std::tolower(c); });
+    return str;
+}
+
+static bool matchesPreference(const std::string& selector, size_t index,
+                              const std::string& name, const std::string& uuid) {
+    auto isDigit = [](unsigned char c) { return std::isdigit(c) != 0; };
+    if (!selector.empty() && std::all_of(selector.begin(), selector.end(), isDigit)) {
+        return std::stoul(selector) == index;
+    }
+    std::string lowerSelector = toLower(selector);
+    auto withoutDashes = [](std::string str) {
+        str.erase(std::remove(str.begin(), str.end(), '-'), str.end());
+        return str;
+    };
+    if (withoutDashes(lowerSelector) == withoutDashes(uuid)) return true;
+    return toLower(name).find(lowerSelector) != std::string::npos;
+}
+
+int Device::scorePhysicalDevice(const vk::raii::PhysicalDevice& physicalDevice,
+                                const vk::raii::SurfaceKHR* surface,
+                                SwapChainSupport& swapChainSupport) const {
+    auto availableExtensions = physicalDevice.enumerateDeviceExtensionProperties();
+    std::set<std::string> requiredExtensions(_extensions.begin(), _extensions.end());
+    for (const auto& extension : availableExtensions) {
+        requiredExtensions.erase(extension.extensionName);
+    }
+    if (!requiredExtensions.empty()) return -1;
+
+    if (surface) {
+        swapChainSupport.capabilities = physicalDevice.getSurfaceCapabilitiesKHR(**surface);
+        swapChainSupport.formats = physicalDevice.getSurfaceFormatsKHR(**surface);
+        swapChainSupport.presentModes = physicalDevice.getSurfacePresentModesKHR(**surface);
+        if (swapChainSupport.formats.empty() || swapChainSupport.presentModes.empty()) return -1;
+    }
+
+    auto queueFamilyProps = physicalDevice.getQueueFamilyProperties();
+    bool hasGraphicsQueue = false;
+    bool hasTransferQueue = false;
+    for (size_t i = 0; i < queueFamilyProps.size(); i++) {
+        const vk::QueueFlags flags = queueFamilyProps[i].queueFlags;
+        if ((flags & vk::QueueFlagBits::eGraphics) &&
+            (!surface || physicalDevice.getSurfaceSupportKHR(i, **surface))) {
+            hasGraphicsQueue = true;
+        }
+        if ((flags & vk::QueueFlagBits::eTransfer) && !(flags & vk::QueueFlagBits::eGraphics)) {
+            hasTransferQueue = true;
+        }
+    }
+    if (!hasGraphicsQueue) return -1;
+
+    auto props = physicalDevice.getProperties();
+    // uploads complete on a timeline semaphore
+    if (props.apiVersion < VK_API_VERSION_1_2) return -1;
+    auto features = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2,
+                                                vk::PhysicalDeviceVulkan12Features>();
+    if (!features.get<vk::PhysicalDeviceVulkan12Features>().timelineSemaphore) return -1;
+
+    int score = 0;
+    switch (props.deviceType) {
+        case vk::PhysicalDeviceType::eDiscreteGpu:
+            score += 1000;
+            break;
+        case vk::PhysicalDeviceType::eIntegratedGpu:
+            score += 500;
+            break;
+        // software implementations (lavapipe, SwiftShader) are accepted, but as a last resort
+        case vk::PhysicalDeviceType::eVirtualGpu:
+            score += 200;
+            break;
+        case vk::PhysicalDeviceType::eCpu:
+            score += 100;
+            break;
+        default:
+            score += 50;
+            break;
+    }
+    if (hasTransferQueue) score += 50; // uploads can overlap rendering
+    if (props.limits.timestampComputeAndGraphics) score += 10;
+
+    // break ties between devices of the same kind with their dedicated memory, 1 point per GiB
+    auto memoryProps = physicalDevice.getMemoryProperties();
+    vk::DeviceSize deviceLocalSize = 0;
+    for (uint32_t i = 0; i < memoryProps.memoryHeapCount; i++) {
+        if (memoryProps.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal) {
+            deviceLocalSize += memoryProps.memoryHeaps[i].size;
+        }
+    }
+    score += (int)std::min<vk::DeviceSize>(deviceLocalSize >> 30, 64);
+    return score;
+}
+
+void Device::selectPhysicalDevice(const vk::raii::SurfaceKHR* surface,
+                                  const DevicePreference& preference) {
     try {
         vk::raii::PhysicalDevices physicalDevices(*_pInstance);
         if (physicalDevices.size() == 0) {
             throw std::runtime_error("No physical device found");
         }
-        int selectedDeviceScore = 0;
-        for (const auto& physicalDevice : physicalDevices) {
-            auto availableExtensions = physicalDevice.enumerateDeviceExtensionProperties();
-            std::set<std::string> requiredExtensions(deviceExtensions.begin(),
-                                                     deviceExtensions.end());
-            for (const auto& extension : availableExtensions) {
-                requiredExtensions.erase(extension.extensionName);
-            }
-            if (!requiredExtensions.empty()) continue;
-
+        int selectedDeviceScore = -1;
+        bool preferenceMatched = false;
+        std::cout << "Available physical devices\n";
+        for (size_t i = 0; i < physicalDevices.size(); i++) {
+            const auto& physicalDevice = physicalDevices[i];
+            auto props = physicalDevice.getProperties();
+            std::string name = props.deviceName.data();
+            std::string uuid = physicalDeviceUuid(physicalDevice);
             SwapChainSupport deviceSwapChainSupport;
-            deviceSwapChainSupport.capabilities =
-                physicalDevice.getSurfaceCapabilitiesKHR(*surface);
-            deviceSwapChainSupport.formats = physicalDevice.getSurfaceFormatsKHR(*surface);
-            deviceSwapChainSupport.presentModes =
-                physicalDevice.getSurfacePresentModesKHR(*surface);
-            if (deviceSwapChainSupport.formats.empty() ||
-                deviceSwapChainSupport.presentModes.empty())
+            int score = scorePhysicalDevice(physicalDevice, surface, deviceSwapChainSupport);
+            std::cout << i << ": " << name << " (" << vk::to_string(props.deviceType) << ", "
+                      << uuid << ") score " << score << '\n';
+            if (!preference.selector.empty()) {
+                if (!matchesPreference(preference.selector, i, name, uuid)) continue;
+                if (score < 0) {
+                    throw std::runtime_error(name + " was requested but is not suitable");
+                }
+                if (preferenceMatched) continue; // the first match wins
+                preferenceMatched = true;
+            } else if (score < 0 || score <= selectedDeviceScore) {
                 continue;
-
-            auto props = physicalDevice.getProperties();
-            auto features = physicalDevice.getFeatures();
-            int score = 0;
-            if (props.deviceType == vk::PhysicalDeviceType::eDiscreteGpu) score += 100;
-            if (props.deviceType == vk::PhysicalDeviceType::eIntegratedGpu) score += 50;
-            if (score >= selectedDeviceScore) {
-                _physicalDevice = physicalDevice;
-                _swapChainSupport = deviceSwapChainSupport;
-                selectedDeviceScore = score;
             }
+            _physicalDevice = physicalDevice;
+            _swapChainSupport = deviceSwapChainSupport;
+            selectedDeviceScore = score;
         }
-        if (selectedDeviceScore == 0) {
+        if (!preference.selector.empty() && !preferenceMatched) {
+            throw std::runtime_error("No physical device matches \"" + preference.selector +
+                                     "\"");
+        }
+        if (selectedDeviceScore < 0) {
             throw std::runtime_error("No physical device could be selected");
         }
         std::cout << _physicalDevice.getProperties().deviceName << " selected\n";
@@ -55,7 +210,7 @@ void Device::selectPhysicalDevice(const vk::raii::SurfaceKHR& surface) {
     }
 }
 
-void Device::listPhysicalDeviceQueueFamilies(const vk::raii::SurfaceKHR& surface) const {
+void Device::listPhysicalDeviceQueueFamilies(const vk::raii::SurfaceKHR* surface) const {
     auto queueFamilyProps = _physicalDevice.getQueueFamilyProperties();
     std::cout << "Available queue families\n";
     for (size_t i = 0; i < queueFamilyProps.size(); i++) {
@@ -66,13 +221,15 @@ void Device::listPhysicalDeviceQueueFamilies(const vk::raii::SurfaceKHR& surface
                   << (queueFamilyProp.queueFlags & vk::QueueFlagBits::eGraphics ? "yes" : "no");
         std::cout << " transfer "
                   << (queueFamilyProp.queueFlags & vk::QueueFlagBits::eTransfer ? "yes" : "no");
-        std::cout << " presentation "
-                  << (_physicalDevice.getSurfaceSupportKHR(i, *surface) ? "yes" : "no");
+        if (surface) {
+            std::cout << " presentation "
+                      << (_physicalDevice.getSurfaceSupportKHR(i, **surface) ? "yes" : "no");
+        }
         std::cout << '\n';
     }
 }
 
-void Device::selectGraphicsQueueFamily(const vk::raii::SurfaceKHR& surface) {
+void Device::selectGraphicsQueueFamily(const vk::raii::SurfaceKHR* surface) {
     try {
         int selectedGraphicsScore = 0;
         auto queueFamilyProps = _physicalDevice.getQueueFamilyProperties();
@@ -85,7 +242,7 @@ void Device::selectGraphicsQueueFamily(const vk::raii::SurfaceKHR& surface) {
             if (!(queueFamilyProp.queueFlags & vk::QueueFlagBits::eTransfer)) {
                 graphicsScore += 50;
             }
-            if (!_physicalDevice.getSurfaceSupportKHR(i, *surface)) {
+            if (surface && !_physicalDevice.getSurfaceSupportKHR(i, **surface)) {
                 graphicsScore = -1; // presentation support
             }
             graphicsScore *= queueFamilyProp.queueCount;
@@ -145,14 +302,25 @@ void Device::createDevice() {
         }
 
         vk::PhysicalDeviceFeatures physicalDeviceFeatures;
+        vk::PhysicalDeviceVulkan12Features vulkan12Features;
+        vulkan12Features.timelineSemaphore = true;
+
+        // optional, VMA reports the budgets of the driver instead of estimating them
+        for (const auto& extension : _physicalDevice.enumerateDeviceExtensionProperties()) {
+            if (std::string(extension.extensionName) == VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) {
+                _memoryBudget = true;
+            }
+        }
+        if (_memoryBudget) _extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
 
         vk::DeviceCreateInfo deviceCreateInfo;
+        deviceCreateInfo.pNext = &vulkan12Features;
         deviceCreateInfo.setQueueCreateInfos(queuesCreateInfo);
         deviceCreateInfo.pEnabledFeatures = &physicalDeviceFeatures;
-        deviceCreateInfo.setPEnabledExtensionNames(deviceExtensions);
-#ifndef NDEBUG
-        deviceCreateInfo.setPEnabledLayerNames(validationLayers);
-#endif
+        deviceCreateInfo.setPEnabledExtensionNames(_extensions);
+        if (_pInstance->validationEnabled()) {
+            deviceCreateInfo.setPEnabledLayerNames(validationLayers);
+        }
         _device = _physicalDevice.createDevice(deviceCreateInfo);
     } catch (std::exception& e) {
         std::cerr << "Error while creating device : " << e.what() << '\n';
@@ -166,12 +334,76 @@ void Device::createAllocator() {
     allocatorCreateInfo.instance = *_pInstance->instance();
     allocatorCreateInfo.physicalDevice = *_physicalDevice;
     allocatorCreateInfo.device = *_device;
+    if (_memoryBudget) allocatorCreateInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
     auto result = vmaCreateAllocator(&allocatorCreateInfo, &_allocator);
     if (result != VkResult::VK_SUCCESS) {
         std::cout << "vmaCreateAllocator failed : " << result << "\n";
     };
 }
 
+VmaPool Device::createMemoryPool(const VkBufferCreateInfo& bufferCreateInfo,
+                                 const VmaAllocationCreateInfo& allocCreateInfo,
+                                 VmaPoolCreateFlags flags, vk::DeviceSize blockSize,
+                                 size_t maxBlockCount) {
+    VmaPoolCreateInfo poolCreateInfo{};
+    auto result = vmaFindMemoryTypeIndexForBufferInfo(_allocator, &bufferCreateInfo,
+                                                      &allocCreateInfo,
+                                                      &poolCreateInfo.memoryTypeIndex);
+    if (result != VkResult::VK_SUCCESS) return VK_NULL_HANDLE;
+    poolCreateInfo.flags = flags;
+    poolCreateInfo.blockSize = blockSize;
+    poolCreateInfo.maxBlockCount = maxBlockCount;
+    VmaPool pool;
+    result = vmaCreatePool(_allocator, &poolCreateInfo, &pool);
+    if (result != VkResult::VK_SUCCESS) {
+        std::cout << "vmaCreatePool failed : " << result << "\n";
+        return VK_NULL_HANDLE;
+    }
+    return pool;
+}
+
+void Device::createMemoryPools() {
+    // the memory types are picked for buffers like the ones Buffer, the readbacks and the
+    // upload spills create
+    VkBufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.size = 1 << 16;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VmaAllocationCreateInfo allocCreateInfo{};
+
+    // the pool is empty between two readbacks, the linear algorithm allocates from its start
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+    allocCreateInfo.flags =
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    _memoryPools[(size_t)MemoryPool::TRANSIENT] =
+        createMemoryPool(bufferCreateInfo, allocCreateInfo, VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT,
+                         TRANSIENT_POOL_SIZE, 1);
+
+    // spills are freed in the order their batches complete, the linear algorithm wraps around
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    allocCreateInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                            VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    _memoryPools[(size_t)MemoryPool::STREAMING] =
+        createMemoryPool(bufferCreateInfo, allocCreateInfo, VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT,
+                         STREAMING_POOL_SIZE, 1);
+
+    // default algorithm and block size, geometry is rarely freed
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                             VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+    allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+    allocCreateInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                            VMA_ALLOCATION_CREATE_HOST_ACCESS_ALLOW_TRANSFER_INSTEAD_BIT |
+                            VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    _memoryPools[(size_t)MemoryPool::GEOMETRY] =
+        createMemoryPool(bufferCreateInfo, allocCreateInfo, 0, 0, 0);
+
+    for (size_t i = 1; i < _memoryPools.size(); i++) {
+        if (_memoryPools[i] == VK_NULL_HANDLE) continue;
+        vmaSetPoolName(_allocator, _memoryPools[i], memoryPoolName((MemoryPool)i));
+    }
+}
+
 void Device::createGraphicsQueue() {
     try {
         _graphicsQueue = _device.getQueue(_graphicsQueueFamily.index, 0);
@@ -217,38 +449,99 @@ void Device::createTransferCommandPool() {
     }
 }
 
-void Device::createGraphicsCommandBuffer() {
-    try {
-        vk::CommandBufferAllocateInfo commandBufferAllocInfo;
-        commandBufferAllocInfo.commandPool = *_graphicsCommandPool;
-        commandBufferAllocInfo.level = vk::CommandBufferLevel::ePrimary;
-        commandBufferAllocInfo.commandBufferCount = 1;
-        _graphicsCommandBuffer =
-            std::move(_device.allocateCommandBuffers(commandBufferAllocInfo).at(0));
-    } catch (std::exception& e) {
-        std::cerr << "Error while creating command buffer : " << e.what() << '\n';
-        exit(-1);
+void Device::createJobSystem(uint32_t workerCount) {
+    _pJobSystem = std::make_unique<render::JobSystem>(workerCount);
+}
+
+void Device::createTimelines() {
+    // without a dedicated transfer family both timelines submit to the same queue
+    auto pGraphicsQueueMutex = std::make_shared<std::mutex>();
+    auto pTransferQueueMutex = (_transferQueueFamily.index == _graphicsQueueFamily.index)
+                                   ? pGraphicsQueueMutex
+                                   : std::make_shared<std::mutex>();
+    _pGraphicsTimeline =
+        std::make_unique<render::Timeline>(_device, _graphicsQueue, pGraphicsQueueMutex);
+    _pTransferTimeline =
+        std::make_unique<render::Timeline>(_device, _transferQueue, pTransferQueueMutex);
+}
+
+void Device::createUploadBatcher() {
+    _pUploadBatcher = std::make_unique<render::UploadBatcher>(
+        _device, _allocator, *_pTransferTimeline, _transferQueueFamily.index,
+        _graphicsQueueFamily.index, ownershipTransfers(), STAGING_RING_SIZE,
+        memoryPool(MemoryPool::STREAMING));
+}
+
+void Device::createDeletionQueue() {
+    _pDeletionQueue =
+        std::make_unique<render::DeletionQueue>(*_pGraphicsTimeline, *_pUploadBatcher);
+}
+
+void Device::fillSharing(VkBufferCreateInfo& bufferCreateInfo,
+                         std::vector<uint32_t>& queueFamilyIndices) const {
+    if (_sharingMode == SharingMode::EXCLUSIVE ||
+        _graphicsQueueFamily.index == _transferQueueFamily.index) {
+        bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        queueFamilyIndices.clear();
+    } else {
+        bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        queueFamilyIndices = {_graphicsQueueFamily.index, _transferQueueFamily.index};
     }
+    bufferCreateInfo.pQueueFamilyIndices = queueFamilyIndices.data();
+    bufferCreateInfo.queueFamilyIndexCount = (uint32_t)queueFamilyIndices.size();
 }
 
-Device::Device(std::shared_ptr<const render::Instance> pInstance, const vk::raii::SurfaceKHR& surface) : _pInstance(pInstance) {
-    selectPhysicalDevice(surface);
+void Device::init(const vk::raii::SurfaceKHR* surface, const DevicePreference& preference) {
+    TRACE_SCOPE("Device::Device");
+    _sharingMode = preference.sharingMode;
+    createJobSystem(preference.jobWorkers);
+    selectPhysicalDevice(surface, preference);
     listPhysicalDeviceQueueFamilies(surface);
     selectGraphicsQueueFamily(surface);
     selectTransferQueueFamily();
     createDevice();
     createAllocator();
+    createMemoryPools();
     createGraphicsQueue();
     createTransferQueue();
     createGraphicsCommandPool();
     createTransferCommandPool();
-    createGraphicsCommandBuffer();
+    createTimelines();
+    createUploadBatcher();
+    createDeletionQueue();
+}
+
+Device::Device(std::shared_ptr<const render::Instance> pInstance, const vk::raii::SurfaceKHR& surface,
+               const DevicePreference& preference)
+    : _pInstance(pInstance), _extensions(presentationExtensions) {
+    init(&surface, preference);
+}
+
+Device::Device(std::shared_ptr<const render::Instance> pInstance,
+               const DevicePreference& preference)
+    : _pInstance(pInstance) {
+    init(nullptr, preference);
 }
 
 Device::~Device() {
+    // the released buffers may still be the destination of uploads, then of frames. Nothing
+    // else submits anymore, the queues do not need their locks.
+    _pUploadBatcher->wait(_pUploadBatcher->flush());
+    _device.waitIdle();
+    _pDeletionQueue.reset();
+    // the staging ring is an allocation, it has to go before the allocator
+    _pUploadBatcher.reset();
+    for (VmaPool pool : _memoryPools) {
+        if (pool != VK_NULL_HANDLE) vmaDestroyPool(_allocator, pool);
+    }
     vmaDestroyAllocator(_allocator);
 }
 
+void Device::waitSubmitted() const {
+    _pGraphicsTimeline->wait(_pGraphicsTimeline->submitted());
+    _pTransferTimeline->wait(_pTransferTimeline->submitted());
+}
+
 uint32_t Device::findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties) const {
     vk::PhysicalDeviceMemoryProperties memProperties = _physicalDevice.getMemoryProperties();
     for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
@@ -1,21 +1,67 @@
 #pragma once
 
 #include <vulkan/vulkan_raii.hpp>
+#include <array>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <string>
 
 #include "instance.hh"
+#include "job_system.hh"
+#include "timeline.hh"
+#include "upload_batcher.hh"
+#include "deletion_queue.hh"
 #include "vk_mem_alloc.h"
 
-const std::vector<const char*> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+// extensions required to present to a surface, a headless device does not need them
+const std::vector<const char*> presentationExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
 namespace render {
+// staging memory shared by every upload to device local buffers
+constexpr vk::DeviceSize STAGING_RING_SIZE = 32ull << 20;
+// blocks of the transient and streaming pools, their linear algorithm needs a single block
+constexpr vk::DeviceSize TRANSIENT_POOL_SIZE = 16ull << 20;
+constexpr vk::DeviceSize STREAMING_POOL_SIZE = STAGING_RING_SIZE;
+
+// Custom VMA pools buffers can be placed in, DEFAULT uses the general purpose heuristics.
+// An allocation which does not fit its pool falls back to DEFAULT.
+enum class MemoryPool {
+    DEFAULT,
+    TRANSIENT, // host visible, linear, buffers freed before the next one is created (readbacks)
+    STREAMING, // host visible, linear used as a ring buffer, staging freed in submission order
+    GEOMETRY,  // device local, large blocks for long lived vertex and index buffers
+    COUNT
+};
+
+const char* memoryPoolName(MemoryPool pool);
+
 struct SwapChainSupport {
     vk::SurfaceCapabilitiesKHR capabilities;
     std::vector<vk::SurfaceFormatKHR> formats;
     std::vector<vk::PresentModeKHR> presentModes;
 };
 
+// How device local buffers are shared when the transfer family differs from the graphics one
+enum class SharingMode {
+    CONCURRENT, // both families access the buffers, no ownership transfer
+    EXCLUSIVE   // the graphics family owns them, uploads release them back after their copies
+};
+
+SharingMode parseSharingMode(const std::string& name);
+const char* sharingModeName(SharingMode mode);
+
+// Which physical device to use. The selector is a device index, a device UUID or a case
+// insensitive substring of the device name, when empty the best scoring device wins.
+struct DevicePreference {
+    std::string selector;
+    SharingMode sharingMode = SharingMode::CONCURRENT;
+    uint32_t jobWorkers = JobSystem::defaultWorkerCount();
+
+    // Reads the selector from PAIN_BAGNAT_DEVICE
+    static DevicePreference fromEnvironment();
+};
+
 struct QueueFamily {
     uint32_t index;
     vk::QueueFamilyProperties properties;
@@ -25,6 +71,8 @@ class Device {
 public:
 private:
     std::shared_ptr<const render::Instance> _pInstance;
+    std::unique_ptr<render::JobSystem> _pJobSystem;
+    std::vector<const char*> _extensions;
     vk::raii::PhysicalDevice _physicalDevice = 0;
     vk::raii::Device _device = 0;
     VmaAllocator _allocator;
@@ -35,22 +83,48 @@ private:
     SwapChainSupport _swapChainSupport;
     vk::raii::CommandPool _graphicsCommandPool = 0;
     vk::raii::CommandPool _transferCommandPool = 0;
-    vk::raii::CommandBuffer _graphicsCommandBuffer = 0;
+    std::unique_ptr<render::Timeline> _pGraphicsTimeline;
+    std::unique_ptr<render::Timeline> _pTransferTimeline;
+    std::unique_ptr<render::UploadBatcher> _pUploadBatcher;
+    std::unique_ptr<render::DeletionQueue> _pDeletionQueue;
+    SharingMode _sharingMode = SharingMode::CONCURRENT;
+    bool _memoryBudget = false; // VK_EXT_memory_budget enabled
+    std::array<VmaPool, (size_t)MemoryPool::COUNT> _memoryPools{};
+    mutable std::mutex _bufferMoveMutex;
 
-    void selectPhysicalDevice(const vk::raii::SurfaceKHR& surface);
-    void listPhysicalDeviceQueueFamilies(const vk::raii::SurfaceKHR& surface) const;
-    void selectGraphicsQueueFamily(const vk::raii::SurfaceKHR& surface);
+    // surface is null for a headless device
+    // returns -1 when the device cannot be used at all
+    int scorePhysicalDevice(const vk::raii::PhysicalDevice& physicalDevice,
+                            const vk::raii::SurfaceKHR* surface,
+                            SwapChainSupport& swapChainSupport) const;
+    void selectPhysicalDevice(const vk::raii::SurfaceKHR* surface,
+                              const DevicePreference& preference);
+    void listPhysicalDeviceQueueFamilies(const vk::raii::SurfaceKHR* surface) const;
+    void selectGraphicsQueueFamily(const vk::raii::SurfaceKHR* surface);
     void selectTransferQueueFamily();
     void createDevice();
     void createAllocator();
+    VmaPool createMemoryPool(const VkBufferCreateInfo& bufferCreateInfo,
+                             const VmaAllocationCreateInfo& allocCreateInfo,
+                             VmaPoolCreateFlags flags, vk::DeviceSize blockSize,
+                             size_t maxBlockCount);
+    void createMemoryPools();
     void createGraphicsQueue();
     void createTransferQueue();
     void createGraphicsCommandPool();
     void createTransferCommandPool();
-    void createGraphicsCommandBuffer();
+    void createJobSystem(uint32_t workerCount);
+    void createTimelines();
+    void createUploadBatcher();
+    void createDeletionQueue();
+    void init(const vk::raii::SurfaceKHR* surface, const DevicePreference& preference);
 
 public:
-    Device(std::shared_ptr<const render::Instance> pInstance, const vk::raii::SurfaceKHR& surface);
+    Device(std::shared_ptr<const render::Instance> pInstance, const vk::raii::SurfaceKHR& surface,
+           const DevicePreference& preference = DevicePreference());
+    // Headless device, it can only render to offscreen targets
+    Device(std::shared_ptr<const render::Instance> pInstance,
+           const DevicePreference& preference = DevicePreference());
     ~Device();
     uint32_t findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties) const;
     const vk::raii::PhysicalDevice& physicalDevice() const {
@@ -74,14 +148,58 @@ public:
     const QueueFamily& transferQueueFamily() const {
         return _transferQueueFamily;
     }
+    // Null for DEFAULT and for the pools no memory type could be found for
+    VmaPool memoryPool(MemoryPool pool) const {
+        return _memoryPools[(size_t)pool];
+    }
+    bool memoryBudgetSupported() const {
+        return _memoryBudget;
+    }
+    SharingMode sharingMode() const {
+        return _sharingMode;
+    }
+    // True when buffers written by the transfer queue change owner, graphics consumers must
+    // then record the acquire barriers of the upload batcher
+    bool ownershipTransfers() const {
+        return _sharingMode == SharingMode::EXCLUSIVE &&
+               _graphicsQueueFamily.index != _transferQueueFamily.index;
+    }
+    // Sharing mode and queue families of the buffers, queueFamilyIndices backs the create info
+    void fillSharing(VkBufferCreateInfo& bufferCreateInfo,
+                     std::vector<uint32_t>& queueFamilyIndices) const;
     const SwapChainSupport& swapChainSupport() const {
         return _swapChainSupport;
     }
     const vk::raii::CommandPool& transferCommandPool() const {
         return _transferCommandPool;
     }
-    const vk::raii::CommandBuffer& graphicsCommandBuffer() const {
-        return _graphicsCommandBuffer;
+    const vk::raii::CommandPool& graphicsCommandPool() const {
+        return _graphicsCommandPool;
+    }
+    // Every graphics submission goes through its timeline, which synchronizes itself. The
+    // transfer timeline is only reachable through the upload batcher, its single submitter.
+    render::Timeline& graphicsTimeline() const {
+        return *_pGraphicsTimeline;
+    }
+    // Blocks until every submission made so far to either queue has completed. Unlike
+    // vkDeviceWaitIdle it needs no queue lock, other threads may keep submitting meanwhile.
+    void waitSubmitted() const;
+    // Scheduler of the loading and recording work, synchronizes itself
+    render::JobSystem& jobSystem() const {
+        return *_pJobSystem;
+    }
+    // Uploads are queued from const references to the device, the batcher synchronizes itself
+    render::UploadBatcher& uploadBatcher() const {
+        return *_pUploadBatcher;
+    }
+    // Resources released from const references too, the queue synchronizes itself
+    render::DeletionQueue& deletionQueue() const {
+        return *_pDeletionQueue;
+    }
+    // Held by the defragmenter while it starts or ends moving buffers and by buffers being
+    // destroyed, so a buffer never goes away halfway through a move
+    std::mutex& bufferMoveMutex() const {
+        return _bufferMoveMutex;
     }
 };
 
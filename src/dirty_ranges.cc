@@ -0,0 +1,31 @@
+#include "dirty_ranges.hh"
+
+#include <algorithm>
+#include <iterator>
+
+namespace render {
+void DirtyRanges::add(size_t offset, size_t size) {
+    if (size == 0) return;
+    size_t end = offset + size;
+    // first range which could touch the new one, the one starting before it may end inside it
+    auto it = _ranges.upper_bound(offset);
+    if (it != _ranges.begin() && std::prev(it)->second >= offset) --it;
+    while (it != _ranges.end() && it->first <= end) {
+        offset = std::min(offset, it->first);
+        end = std::max(end, it->second);
+        _bytes -= it->second - it->first;
+        it = _ranges.erase(it);
+    }
+    _ranges.emplace(offset, end);
+    _bytes += end - offset;
+}
+
+std::vector<ByteRange> DirtyRanges::take() {
+    std::vector<ByteRange> ranges;
+    ranges.reserve(_ranges.size());
+    for (const auto& [offset, end] : _ranges) ranges.push_back(ByteRange{offset, end - offset});
+    _ranges.clear();
+    _bytes = 0;
+    return ranges;
+}
+} // namespace render
\ No newline at end of file
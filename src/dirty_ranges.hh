@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+namespace render {
+struct ByteRange {
+    size_t offset;
+    size_t size;
+};
+
+// Set of byte ranges written since the last flush, overlapping and adjacent ranges are merged
+// as they are added so a flush copies every changed byte exactly once.
+class DirtyRanges {
+private:
+    std::map<size_t, size_t> _ranges; // offset to end
+    size_t _bytes = 0;
+
+public:
+    void add(size_t offset, size_t size);
+    // Returns the merged ranges in offset order and clears the set
+    std::vector<ByteRange> take();
+
+    bool empty() const {
+        return _ranges.empty();
+    }
+    // Bytes covered by the ranges
+    size_t bytes() const {
+        return _bytes;
+    }
+};
+} // namespace render
\ No newline at end of file
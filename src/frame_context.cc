@@ -0,0 +1,60 @@
+#include "frame_context.hh"
+
+#include <iostream>
+
+namespace render {
+void FrameContext::createCommandPool() {
+    try {
+        vk::CommandPoolCreateInfo commandPoolInfo;
+        commandPoolInfo.flags = vk::CommandPoolCreateFlagBits::eTransient;
+        commandPoolInfo.queueFamilyIndex = _pDevice->graphicsQueueFamily().index;
+        _commandPool = _pDevice->device().createCommandPool(commandPoolInfo);
+    } catch (std::exception& e) {
+        std::cerr << "Error while creating frame command pool : " << e.what() << '\n';
+        exit(-1);
+    }
+}
+
+void FrameContext::createCommandBuffer() {
+    try {
+        vk::CommandBufferAllocateInfo commandBufferAllocInfo;
+        commandBufferAllocInfo.commandPool = *_commandPool;
+        commandBufferAllocInfo.level = vk::CommandBufferLevel::ePrimary;
+        commandBufferAllocInfo.commandBufferCount = 1;
+        _commandBuffer =
+            std::move(_pDevice->device().allocateCommandBuffers(commandBufferAllocInfo).at(0));
+    } catch (std::exception& e) {
+        std::cerr << "Error while creating frame command buffer : " << e.what() << '\n';
+        exit(-1);
+    }
+}
+
+void FrameContext::createSyncObjects() {
+    try {
+        vk::SemaphoreCreateInfo semaphoreInfo;
+        _imageAvailableSemaphore = _pDevice->device().createSemaphore(semaphoreInfo);
+    } catch (std::exception& e) {
+        std::cerr << "Error while creating sync elements : " << e.what() << '\n';
+        exit(-1);
+    }
+}
+
+FrameContext::FrameContext(std::shared_ptr<const render::Device> pDevice) : _pDevice(pDevice) {
+    createCommandPool();
+    createCommandBuffer();
+    createSyncObjects();
+}
+
+void FrameContext::waitAndReset() {
+    _pDevice->graphicsTimeline().wait(_submitValue);
+    _commandPool.reset();
+    _pDevice->deletionQueue().retire();
+}
+
+FrameRing::FrameRing(std::shared_ptr<const render::Device> pDevice, uint32_t framesInFlight) {
+    _frames.reserve(framesInFlight);
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        _frames.push_back(std::make_unique<render::FrameContext>(pDevice));
+    }
+}
+} // namespace render
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include <vector>
+#include <memory>
+
+#include "device.hh"
+
+namespace render {
+// Everything a single frame needs while the GPU may still be working on the previous ones.
+class FrameContext {
+private:
+    std::shared_ptr<const render::Device> _pDevice;
+    vk::raii::CommandPool _commandPool = 0;
+    vk::raii::CommandBuffer _commandBuffer = 0;
+    vk::raii::Semaphore _imageAvailableSemaphore = 0;
+    uint64_t _submitValue = 0; // graphics timeline value of the last submission
+
+    void createCommandPool();
+    void createCommandBuffer();
+    void createSyncObjects();
+
+public:
+    FrameContext(std::shared_ptr<const render::Device> pDevice);
+    FrameContext(const FrameContext&) = delete;
+    FrameContext& operator=(const FrameContext&) = delete;
+
+    // Blocks until the GPU is done with the previous use of this context, then rearms it and
+    // destroys the resources released up to that use
+    void waitAndReset();
+
+    const vk::raii::CommandBuffer& commandBuffer() const {
+        return _commandBuffer;
+    }
+    const vk::raii::Semaphore& imageAvailableSemaphore() const {
+        return _imageAvailableSemaphore;
+    }
+    // The submission of the frame recorded with this context
+    void setSubmitValue(uint64_t value) {
+        _submitValue = value;
+    }
+    uint64_t submitValue() const {
+        return _submitValue;
+    }
+};
+
+// Ring of frame contexts, the CPU records into one while the GPU consumes the others.
+class FrameRing {
+private:
+    std::vector<std::unique_ptr<render::FrameContext>> _frames;
+    uint64_t _frameNumber = 0;
+
+public:
+    FrameRing(std::shared_ptr<const render::Device> pDevice, uint32_t framesInFlight);
+
+    render::FrameContext& current() {
+        return *_frames[currentIndex()];
+    }
+    uint32_t currentIndex() const {
+        return (uint32_t)(_frameNumber % _frames.size());
+    }
+    void advance() {
+        _frameNumber++;
+    }
+    uint64_t frameNumber() const {
+        return _frameNumber;
+    }
+    uint32_t size() const {
+        return (uint32_t)_frames.size();
+    }
+};
+} // namespace render
\ No newline at end of file
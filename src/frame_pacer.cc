@@ -0,0 +1,76 @@
+#include "frame_pacer.hh"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+namespace render {
+PacingPolicy parsePacingPolicy(const std::string& name) {
+    if (name == "uncapped") return PacingPolicy::UNCAPPED;
+    if (name == "fixed") return PacingPolicy::FIXED_RATE;
+    if (name == "present") return PacingPolicy::PRESENT_DRIVEN;
+    throw std::runtime_error("unknown pacing policy " + name);
+}
+
+const char* pacingPolicyName(PacingPolicy policy) {
+    switch (policy) {
+        case PacingPolicy::UNCAPPED:
+            return "uncapped";
+        case PacingPolicy::FIXED_RATE:
+            return "fixed";
+        case PacingPolicy::PRESENT_DRIVEN:
+            return "present";
+    }
+    return "unknown";
+}
+
+FramePacer::FramePacer(PacingPolicy policy, double targetHz)
+    : _policy(policy),
+      _period(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(
+          targetHz > 0.0 ? 1.0 / targetHz : 0.0))),
+      _spinTail(std::chrono::microseconds(500)),
+      _deadline(Clock::now() + _period) {
+}
+
+void FramePacer::waitForDeadline() {
+    Clock::time_point now = Clock::now();
+    if (now >= _deadline) {
+        // we missed the deadline, restart the schedule from now rather than bursting to catch up
+        if (now - _deadline > _period) _deadline = now;
+        return;
+    }
+    // the scheduler wakes us up late by a variable amount, so only sleep for the bulk of the wait
+    // and spin on the clock for the tail
+    if (_deadline - now > _spinTail) {
+        std::this_thread::sleep_until(_deadline - _spinTail);
+        now = Clock::now();
+        if (now > _deadline) {
+            // overslept, widen the tail for the next frames
+            _spinTail = std::min<Clock::duration>(_spinTail + (now - _deadline),
+                                                  std::chrono::milliseconds(2));
+        }
+    }
+    while (Clock::now() < _deadline) {
+        std::this_thread::yield();
+    }
+}
+
+void FramePacer::waitForNextFrame() {
+    if (_policy == PacingPolicy::FIXED_RATE) {
+        waitForDeadline();
+        _deadline += _period;
+    }
+}
+
+vk::PresentModeKHR FramePacer::preferredPresentMode() const {
+    switch (_policy) {
+        case PacingPolicy::UNCAPPED:
+            return vk::PresentModeKHR::eImmediate;
+        case PacingPolicy::FIXED_RATE:
+            return vk::PresentModeKHR::eMailbox;
+        case PacingPolicy::PRESENT_DRIVEN:
+            return vk::PresentModeKHR::eFifo;
+    }
+    return vk::PresentModeKHR::eFifo;
+}
+} // namespace render
\ No newline at end of file
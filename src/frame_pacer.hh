@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <chrono>
+#include <string>
+
+namespace render {
+enum class PacingPolicy {
+    UNCAPPED,      // start the next frame as soon as possible
+    FIXED_RATE,    // sleep until the next deadline, then spin for the last stretch
+    PRESENT_DRIVEN // no CPU wait, the FIFO swapchain blocks acquire at the display rate
+};
+
+PacingPolicy parsePacingPolicy(const std::string& name);
+const char* pacingPolicyName(PacingPolicy policy);
+
+class FramePacer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    PacingPolicy _policy;
+    Clock::duration _period;
+    Clock::duration _spinTail;
+    Clock::time_point _deadline;
+
+    void waitForDeadline();
+
+public:
+    FramePacer(PacingPolicy policy, double targetHz);
+
+    // Ends the current frame and blocks until the next one should start.
+    void waitForNextFrame();
+
+    // Present mode that matches the policy, the swapchain falls back to FIFO when unsupported.
+    vk::PresentModeKHR preferredPresentMode() const;
+
+    PacingPolicy policy() const {
+        return _policy;
+    }
+};
+} // namespace render
\ No newline at end of file
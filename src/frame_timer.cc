@@ -0,0 +1,302 @@
+#include "frame_timer.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+
+#include "clock.hh"
+#include "trace.hh"
+
+namespace render {
+const char* framePhaseName(FramePhase phase) {
+    switch (phase) {
+        case FramePhase::PACING:
+            return "pacing";
+        case FramePhase::TIMELINE_WAIT:
+            return "timeline_wait";
+        case FramePhase::ACQUIRE:
+            return "acquire";
+        case FramePhase::RECORD:
+            return "record";
+        case FramePhase::SUBMIT:
+            return "submit";
+        case FramePhase::PRESENT:
+            return "present";
+        case FramePhase::COUNT:
+            break;
+    }
+    return "unknown";
+}
+
+double FrameRecord::cpuWorkTime() const {
+    return frameTime - phaseTimes[static_cast<size_t>(FramePhase::PACING)] -
+           phaseTimes[static_cast<size_t>(FramePhase::TIMELINE_WAIT)] -
+           phaseTimes[static_cast<size_t>(FramePhase::ACQUIRE)];
+}
+
+FrameTimer::Scope::Scope(FrameTimer& timer, FramePhase phase)
+    : _timer(timer), _phase(phase), _start(Clock::now()) {
+}
+
+static uint64_t toNanoseconds(FrameTimer::Clock::time_point timePoint) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(timePoint.time_since_epoch())
+        .count();
+}
+
+FrameTimer::Scope::~Scope() {
+    Clock::time_point end = Clock::now();
+    _timer.addPhaseTime(_phase, std::chrono::duration<double>(end - _start).count());
+    if (Tracer::enabled()) {
+        Tracer::record(framePhaseName(_phase), toNanoseconds(_start), toNanoseconds(end));
+    }
+}
+
+FrameTimer::FrameTimer(size_t capacity) : _lastReportTime(Clock::now()) {
+    _capacity = 1;
+    while (_capacity < capacity) _capacity <<= 1;
+    _slots = std::make_unique<Slot[]>(_capacity);
+}
+
+size_t FrameTimer::histogramBucket(double frameTime) {
+    double ms = frameTime * 1000.0;
+    for (size_t i = 0; i + 1 < HISTOGRAM_BOUNDS.size(); i++) {
+        if (ms < HISTOGRAM_BOUNDS[i]) return i;
+    }
+    return HISTOGRAM_BOUNDS.size() - 1;
+}
+
+void FrameTimer::beginFrame() {
+    _current = FrameRecord();
+    _frameStart = Clock::now();
+    _frameCpuStart = threadCpuTime();
+}
+
+void FrameTimer::endFrame() {
+    Clock::time_point frameEnd = Clock::now();
+    _current.frameTime = std::chrono::duration<double>(frameEnd - _frameStart).count();
+    if (Tracer::enabled()) {
+        Tracer::record("frame", toNanoseconds(_frameStart), toNanoseconds(frameEnd));
+    }
+    _current.cpuTime = std::chrono::duration<double>(threadCpuTime() - _frameCpuStart).count();
+
+    // single producer, the slot is filled before the new count is published
+    uint64_t frameNumber = _published.load(std::memory_order_relaxed);
+    _current.frameNumber = frameNumber;
+    Slot& slot = _slots[frameNumber & (_capacity - 1)];
+    uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::array<uint64_t, RECORD_WORDS> words;
+    std::memcpy(words.data(), &_current, sizeof(FrameRecord));
+    for (size_t i = 0; i < RECORD_WORDS; i++) {
+        slot.words[i].store(words[i], std::memory_order_relaxed);
+    }
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    _published.store(frameNumber + 1, std::memory_order_release);
+
+    _histogram[histogramBucket(_current.frameTime)].fetch_add(1, std::memory_order_relaxed);
+    uint64_t frameTimeNs = (uint64_t)(_current.frameTime * 1e9);
+    uint64_t maxFrameTimeNs = _maxFrameTimeNs.load(std::memory_order_relaxed);
+    while (frameTimeNs > maxFrameTimeNs &&
+           !_maxFrameTimeNs.compare_exchange_weak(maxFrameTimeNs, frameTimeNs)) {
+    }
+}
+
+std::vector<FrameRecord> FrameTimer::snapshot(uint64_t since) const {
+    uint64_t published = _published.load(std::memory_order_acquire);
+    uint64_t first = std::max(since, published > _capacity ? published - _capacity : 0);
+    std::vector<FrameRecord> records;
+    records.reserve(published - std::min(first, published));
+    for (uint64_t i = first; i < published; i++) {
+        const Slot& slot = _slots[i & (_capacity - 1)];
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence & 1) continue; // a newer frame is being written over it
+        std::array<uint64_t, RECORD_WORDS> words;
+        for (size_t j = 0; j < RECORD_WORDS; j++) {
+            words[j] = slot.words[j].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // the producer wrote the slot again while we were copying it
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) continue;
+        FrameRecord record;
+        std::memcpy(&record, words.data(), sizeof(FrameRecord));
+        if (record.frameNumber == i) records.push_back(record);
+    }
+    return records;
+}
+
+TimingSummary FrameTimer::summarize(std::vector<double> samples) {
+    TimingSummary summary;
+    if (samples.empty()) return summary;
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&](double p) {
+        size_t index = (size_t)(p * (samples.size() - 1) + 0.5);
+        return samples[std::min(index, samples.size() - 1)];
+    };
+    double total = 0.0;
+    for (double sample : samples) total += sample;
+    summary.mean = total / samples.size();
+    summary.p50 = percentile(0.50);
+    summary.p90 = percentile(0.90);
+    summary.p99 = percentile(0.99);
+    summary.max = samples.back();
+    return summary;
+}
+
+bool FrameTimer::reportDue(double interval) const {
+    return std::chrono::duration<double>(Clock::now() - _lastReportTime).count() > interval;
+}
+
+// GPU times of the frames which have one, and how many of them the GPU took longer than the CPU
+static std::vector<double> resolvedGpuTimes(const std::vector<FrameRecord>& records,
+                                            size_t& gpuBoundFrames) {
+    std::vector<double> gpuSamples;
+    gpuBoundFrames = 0;
+    for (const auto& record : records) {
+        if (record.gpuTime < 0.0) continue;
+        gpuSamples.push_back(record.gpuTime);
+        if (record.gpuTime > record.cpuWorkTime()) gpuBoundFrames++;
+    }
+    return gpuSamples;
+}
+
+void printTimingSummary(std::ostream& os, const char* name, const TimingSummary& summary) {
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << "  " << std::left << std::setw(12) << name << std::right << std::fixed
+       << std::setprecision(3);
+    for (double value : {summary.mean, summary.p50, summary.p90, summary.p99, summary.max}) {
+        os << std::setw(10) << value * 1000.0;
+    }
+    os << '\n';
+    os.flags(flags);
+    os.precision(precision);
+}
+
+static void printRecords(std::ostream& os, const std::vector<FrameRecord>& records,
+                         const FrameTimer::Histogram& histogram) {
+    if (records.empty()) {
+        os << "FRAME TIMES : no frame\n";
+        return;
+    }
+    double wallTime = 0.0;
+    double cpuTime = 0.0;
+    for (const auto& record : records) {
+        wallTime += record.frameTime;
+        cpuTime += record.cpuTime;
+    }
+    os << "FRAME TIMES : " << records.size() << " frames, " << records.size() / wallTime
+       << " fps, CPU busy " << 1000.0 * cpuTime / records.size() << " ms/frame ("
+       << 100.0 * cpuTime / wallTime << "% of a core)\n";
+    os << "  " << std::left << std::setw(12) << "ms" << std::right;
+    for (const char* column : {"mean", "p50", "p90", "p99", "max"}) {
+        os << std::setw(10) << column;
+    }
+    os << '\n';
+    std::vector<double> samples(records.size());
+    for (size_t phase = 0; phase < FRAME_PHASE_COUNT; phase++) {
+        for (size_t i = 0; i < records.size(); i++) {
+            samples[i] = records[i].phaseTimes[phase];
+        }
+        printTimingSummary(os, framePhaseName(static_cast<FramePhase>(phase)),
+                         FrameTimer::summarize(samples));
+    }
+    for (size_t i = 0; i < records.size(); i++) samples[i] = records[i].cpuTime;
+    printTimingSummary(os, "cpu", FrameTimer::summarize(samples));
+    for (size_t i = 0; i < records.size(); i++) samples[i] = records[i].frameTime;
+    printTimingSummary(os, "frame", FrameTimer::summarize(samples));
+
+    size_t gpuBoundFrames = 0;
+    std::vector<double> gpuSamples = resolvedGpuTimes(records, gpuBoundFrames);
+    if (!gpuSamples.empty()) {
+        printTimingSummary(os, "gpu", FrameTimer::summarize(gpuSamples));
+        os << "  bound by the GPU in " << 100.0 * gpuBoundFrames / gpuSamples.size()
+           << "% of the frames, by the CPU in "
+           << 100.0 * (gpuSamples.size() - gpuBoundFrames) / gpuSamples.size() << "%\n";
+    }
+
+    os << "  histogram";
+    double lowerBound = 0.0;
+    for (size_t i = 0; i < histogram.size(); i++) {
+        double upperBound = FrameTimer::HISTOGRAM_BOUNDS[i];
+        if (i + 1 < histogram.size()) {
+            os << " [" << lowerBound << "-" << upperBound << "[ " << histogram[i];
+        } else {
+            os << " [" << lowerBound << "-[ " << histogram[i];
+        }
+        lowerBound = upperBound;
+    }
+    os << '\n';
+}
+
+void FrameTimer::printReport(std::ostream& os) {
+    std::vector<FrameRecord> records = snapshot(_lastReportedFrame);
+    Histogram histogram{};
+    for (const auto& record : records) histogram[histogramBucket(record.frameTime)]++;
+    printRecords(os, records, histogram);
+    _lastReportedFrame = frameCount();
+    _lastReportTime = Clock::now();
+}
+
+void FrameTimer::printSummary(std::ostream& os) const {
+    Histogram histogram{};
+    for (size_t i = 0; i < histogram.size(); i++) {
+        histogram[i] = _histogram[i].load(std::memory_order_relaxed);
+    }
+    printRecords(os, snapshot(), histogram);
+}
+
+void writeTimingSummaryJson(JsonWriter& writer, const TimingSummary& summary) {
+    writer.beginObject();
+    writer.key("mean_ms").value(summary.mean * 1000.0);
+    writer.key("p50_ms").value(summary.p50 * 1000.0);
+    writer.key("p90_ms").value(summary.p90 * 1000.0);
+    writer.key("p99_ms").value(summary.p99 * 1000.0);
+    writer.key("max_ms").value(summary.max * 1000.0);
+    writer.endObject();
+}
+
+void FrameTimer::writeJson(JsonWriter& writer) const {
+    std::vector<FrameRecord> records = snapshot();
+    std::vector<double> samples(records.size());
+    writer.beginObject();
+    writer.key("frames").value(frameCount());
+    writer.key("sampled_frames").value((uint64_t)records.size());
+    writer.key("max_frame_ms").value(_maxFrameTimeNs.load(std::memory_order_relaxed) / 1e6);
+    writer.key("phases").beginObject();
+    for (size_t phase = 0; phase < FRAME_PHASE_COUNT; phase++) {
+        for (size_t i = 0; i < records.size(); i++) {
+            samples[i] = records[i].phaseTimes[phase];
+        }
+        writer.key(framePhaseName(static_cast<FramePhase>(phase)));
+        writeTimingSummaryJson(writer, summarize(samples));
+    }
+    writer.endObject();
+    for (size_t i = 0; i < records.size(); i++) samples[i] = records[i].cpuTime;
+    writer.key("cpu");
+    writeTimingSummaryJson(writer, summarize(samples));
+    for (size_t i = 0; i < records.size(); i++) samples[i] = records[i].frameTime;
+    writer.key("frame");
+    writeTimingSummaryJson(writer, summarize(samples));
+    size_t gpuBoundFrames = 0;
+    std::vector<double> gpuSamples = resolvedGpuTimes(records, gpuBoundFrames);
+    if (!gpuSamples.empty()) {
+        writer.key("gpu");
+        writeTimingSummaryJson(writer, summarize(gpuSamples));
+        writer.key("gpu_bound_ratio").value((double)gpuBoundFrames / gpuSamples.size());
+    }
+    writer.key("histogram").beginArray();
+    for (size_t i = 0; i < HISTOGRAM_BOUNDS.size(); i++) {
+        writer.beginObject();
+        if (i + 1 < HISTOGRAM_BOUNDS.size()) {
+            writer.key("below_ms").value(HISTOGRAM_BOUNDS[i]);
+        } else {
+            writer.key("below_ms").raw("null");
+        }
+        writer.key("count").value(_histogram[i].load(std::memory_order_relaxed));
+        writer.endObject();
+    }
+    writer.endArray();
+    writer.endObject();
+}
+} // namespace render
\ No newline at end of file
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "json_writer.hh"
+
+namespace render {
+enum class FramePhase {
+    PACING,
+    TIMELINE_WAIT, // for the previous frame of the slot, on the graphics timeline
+    ACQUIRE,
+    RECORD,
+    SUBMIT,
+    PRESENT,
+    COUNT
+};
+
+constexpr size_t FRAME_PHASE_COUNT = static_cast<size_t>(FramePhase::COUNT);
+
+const char* framePhaseName(FramePhase phase);
+
+struct FrameRecord {
+    uint64_t frameNumber = 0;
+    std::array<double, FRAME_PHASE_COUNT> phaseTimes{}; // seconds
+    double frameTime = 0.0;                             // wall time, seconds
+    double cpuTime = 0.0;                               // thread CPU time, seconds
+    // GPU time of the most recently resolved frame, the results lag a few frames behind,
+    // negative when unknown
+    double gpuTime = -1.0;
+
+    // Time the CPU spent actually working rather than waiting on the GPU or the pacer
+    double cpuWorkTime() const;
+};
+
+struct TimingSummary {
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+void printTimingSummary(std::ostream& os, const char* name, const TimingSummary& summary);
+void writeTimingSummaryJson(JsonWriter& writer, const TimingSummary& summary);
+
+// Per-phase CPU timings of every frame. Records are published into a ring by the thread driving
+// the frames and can be read from any thread without locking: every slot carries a sequence
+// number the reader checks around its copy, records overwritten meanwhile are dropped.
+class FrameTimer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // upper bounds of the frame time histogram buckets in milliseconds, the last one is open
+    static constexpr std::array<double, 9> HISTOGRAM_BOUNDS = {1.0,  2.0,  4.0,   8.0, 16.7,
+                                                               33.3, 50.0, 100.0, 0.0};
+    using Histogram = std::array<uint64_t, HISTOGRAM_BOUNDS.size()>;
+
+    class Scope {
+    private:
+        FrameTimer& _timer;
+        FramePhase _phase;
+        Clock::time_point _start;
+
+    public:
+        Scope(FrameTimer& timer, FramePhase phase);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+private:
+    static constexpr size_t RECORD_WORDS = sizeof(FrameRecord) / sizeof(uint64_t);
+    static_assert(sizeof(FrameRecord) % sizeof(uint64_t) == 0, "records are copied in words");
+
+    // the record is stored as atomic words so a copy racing with the producer is not a data race
+    struct Slot {
+        std::atomic<uint64_t> sequence{0}; // odd while the producer writes the slot
+        std::array<std::atomic<uint64_t>, RECORD_WORDS> words{};
+    };
+
+    std::unique_ptr<Slot[]> _slots;
+    size_t _capacity;
+    std::atomic<uint64_t> _published{0};
+    FrameRecord _current;
+    Clock::time_point _frameStart;
+    std::chrono::nanoseconds _frameCpuStart{0};
+    std::array<std::atomic<uint64_t>, HISTOGRAM_BOUNDS.size()> _histogram{};
+    std::atomic<uint64_t> _maxFrameTimeNs{0};
+    Clock::time_point _lastReportTime;
+    uint64_t _lastReportedFrame = 0;
+
+    static size_t histogramBucket(double frameTime);
+
+public:
+    // capacity is rounded up to a power of two
+    FrameTimer(size_t capacity = 4096);
+
+    void beginFrame();
+    void endFrame();
+    Scope scope(FramePhase phase) {
+        return Scope(*this, phase);
+    }
+    void addPhaseTime(FramePhase phase, double seconds) {
+        _current.phaseTimes[static_cast<size_t>(phase)] += seconds;
+    }
+    void setGpuTime(double seconds) {
+        _current.gpuTime = seconds;
+    }
+
+    uint64_t frameCount() const {
+        return _published.load(std::memory_order_acquire);
+    }
+    // Copies the records published since the given frame which are still in the ring
+    std::vector<FrameRecord> snapshot(uint64_t since = 0) const;
+
+    static TimingSummary summarize(std::vector<double> samples);
+
+    bool reportDue(double interval) const;
+    // Prints the frames published since the previous periodic report
+    void printReport(std::ostream& os);
+    // Prints every frame still in the ring along with the all-time histogram
+    void printSummary(std::ostream& os) const;
+    void writeJson(JsonWriter& writer) const;
+};
+} // namespace render
\ No newline at end of file
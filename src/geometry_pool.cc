@@ -0,0 +1,98 @@
+#include "geometry_pool.hh"
+
+#include <iomanip>
+#include <iostream>
+
+namespace render {
+GeometryPool::GeometryPool(std::shared_ptr<const render::Device> pDevice, size_t vertexStride,
+                           uint32_t vertexCapacity, uint32_t indexCapacity)
+    : _pDevice(pDevice),
+      _vertexStride(vertexStride),
+      _pVertexBuffer(std::make_unique<render::Buffer>(*pDevice, vertexStride * vertexCapacity,
+                                                      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                                      render::MemoryPool::GEOMETRY)),
+      _pIndexBuffer(std::make_unique<render::Buffer>(*pDevice, sizeof(uint32_t) * indexCapacity,
+                                                     VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                                     render::MemoryPool::GEOMETRY)),
+      _vertexAllocator(vertexCapacity),
+      _indexAllocator(indexCapacity) {
+}
+
+MeshHandle GeometryPool::allocate(uint32_t vertexCount, uint32_t indexCount) {
+    uint64_t baseVertex, firstIndex;
+    if (!_vertexAllocator.allocate(vertexCount, baseVertex)) return MeshHandle();
+    if (!_indexAllocator.allocate(indexCount, firstIndex)) {
+        _vertexAllocator.free(baseVertex);
+        return MeshHandle();
+    }
+    _meshCount++;
+    return MeshHandle{(uint32_t)baseVertex, vertexCount, (uint32_t)firstIndex, indexCount};
+}
+
+void GeometryPool::free(const MeshHandle& mesh) {
+    if (!mesh.valid()) return;
+    _vertexAllocator.free(mesh.baseVertex);
+    _indexAllocator.free(mesh.firstIndex);
+    _meshCount--;
+}
+
+void GeometryPool::write(const MeshHandle& mesh, const void* vertices,
+                         const uint32_t* indices) {
+    _pVertexBuffer->update(_vertexStride * mesh.baseVertex, vertices,
+                           _vertexStride * mesh.vertexCount);
+    _pIndexBuffer->update(sizeof(uint32_t) * mesh.firstIndex, indices,
+                          sizeof(uint32_t) * mesh.indexCount);
+}
+
+render::UploadToken GeometryPool::flush() {
+    render::UploadToken token = _pVertexBuffer->flush(*_pDevice);
+    token.merge(_pIndexBuffer->flush(*_pDevice));
+    return token;
+}
+
+void GeometryPool::bind(const vk::raii::CommandBuffer& commandBuffer) const {
+    commandBuffer.bindVertexBuffers(0, {_pVertexBuffer->buffer()}, {0});
+    commandBuffer.bindIndexBuffer(_pIndexBuffer->buffer(), 0, vk::IndexType::eUint32);
+}
+
+static void printAllocatorStats(std::ostream& os, const char* name,
+                                const OffsetAllocator& allocator) {
+    os << "  " << std::left << std::setw(8) << name << std::right << allocator.used() << " / "
+       << allocator.capacity() << " used ("
+       << (allocator.capacity() ? 100.0 * allocator.used() / allocator.capacity() : 0.0)
+       << "%), " << allocator.freeBlockCount() << " free blocks, largest "
+       << allocator.largestFreeBlock() << ", fragmentation "
+       << 100.0 * allocator.fragmentation() << "%\n";
+}
+
+void GeometryPool::printStats(std::ostream& os) const {
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(1);
+    os << "GEOMETRY POOL : " << _meshCount << " meshes\n";
+    printAllocatorStats(os, "vertices", _vertexAllocator);
+    printAllocatorStats(os, "indices", _indexAllocator);
+    os.flags(flags);
+    os.precision(precision);
+}
+
+static void writeAllocatorJson(JsonWriter& writer, const OffsetAllocator& allocator) {
+    writer.beginObject();
+    writer.key("capacity").value(allocator.capacity());
+    writer.key("used").value(allocator.used());
+    writer.key("free_blocks").value((uint64_t)allocator.freeBlockCount());
+    writer.key("largest_free_block").value(allocator.largestFreeBlock());
+    writer.key("fragmentation").value(allocator.fragmentation());
+    writer.endObject();
+}
+
+void GeometryPool::writeJson(JsonWriter& writer) const {
+    writer.beginObject();
+    writer.key("meshes").value(_meshCount);
+    writer.key("vertices");
+    writeAllocatorJson(writer, _vertexAllocator);
+    writer.key("indices");
+    writeAllocatorJson(writer, _indexAllocator);
+    writer.endObject();
+}
+} // namespace render
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+
+#include "device.hh"
+#include "buffer.hh"
+#include "offset_allocator.hh"
+#include "json_writer.hh"
+
+namespace render {
+// Where a mesh lives in the geometry pool, baseVertex is the vertexOffset of its draws
+struct MeshHandle {
+    uint32_t baseVertex = 0;
+    uint32_t vertexCount = 0;
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+
+    bool valid() const {
+        return vertexCount != 0;
+    }
+};
+
+// One large device local vertex buffer and one index buffer shared by every mesh of a vertex
+// format. Meshes are sub-allocated in vertices and indices, so all of them are drawn after a
+// single bind of the two buffers.
+class GeometryPool {
+private:
+    std::shared_ptr<const render::Device> _pDevice;
+    size_t _vertexStride;
+    std::unique_ptr<render::Buffer> _pVertexBuffer;
+    std::unique_ptr<render::Buffer> _pIndexBuffer;
+    render::OffsetAllocator _vertexAllocator; // in vertices
+    render::OffsetAllocator _indexAllocator;  // in indices
+    uint32_t _meshCount = 0;
+
+public:
+    GeometryPool(std::shared_ptr<const render::Device> pDevice, size_t vertexStride,
+                 uint32_t vertexCapacity, uint32_t indexCapacity);
+    GeometryPool(const GeometryPool&) = delete;
+    GeometryPool& operator=(const GeometryPool&) = delete;
+
+    // Returns an invalid handle when the pool is out of space
+    MeshHandle allocate(uint32_t vertexCount, uint32_t indexCount);
+    void free(const MeshHandle& mesh);
+    // Writes the mesh, its indices are relative to it. The mesh must not be in use by the GPU,
+    // nothing reaches it before flush.
+    void write(const MeshHandle& mesh, const void* vertices, const uint32_t* indices);
+    // Uploads the meshes written since the previous flush, neighbouring meshes as one range
+    render::UploadToken flush();
+
+    void bind(const vk::raii::CommandBuffer& commandBuffer) const;
+    // Changes whenever the defragmenter moves one of the buffers bind uses
+    uint64_t generation() const {
+        return _pVertexBuffer->generation() + _pIndexBuffer->generation();
+    }
+
+    void printStats(std::ostream& os) const;
+    void writeJson(JsonWriter& writer) const;
+};
+} // namespace render
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "gpu_profiler.hh"
+
+#include <algorithm>
+#include <iostream>
+
+#include "frame_timer.hh"
+
+namespace render {
+GpuProfiler::Scope::Scope(GpuProfiler& profiler, const vk::raii::CommandBuffer& commandBuffer,
+                          const char* name)
+    : _profiler(profiler),
+      _commandBuffer(commandBuffer),
+      _region(profiler.beginRegion(commandBuffer, name)) {
+}
+
+GpuProfiler::Scope::~Scope() {
+    _profiler.endRegion(_commandBuffer, _region);
+}
+
+GpuProfiler::GpuProfiler(std::shared_ptr<const render::Device> pDevice, uint32_t framesInFlight,
+                         uint32_t maxRegions, size_t maxSamples)
+    : _pDevice(pDevice), _maxRegions(maxRegions), _maxSamples(maxSamples) {
+    uint32_t validBits = _pDevice->graphicsQueueFamily().properties.timestampValidBits;
+    auto props = _pDevice->physicalDevice().getProperties();
+    _supported = validBits > 0 && props.limits.timestampPeriod > 0.0f;
+    if (!_supported) {
+        std::cout << "Timestamp queries are not supported on the graphics queue, GPU timings "
+                     "are disabled\n";
+        return;
+    }
+    _timestampPeriod = props.limits.timestampPeriod;
+    _timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+    createQueryPools(framesInFlight);
+}
+
+void GpuProfiler::createQueryPools(uint32_t framesInFlight) {
+    try {
+        vk::QueryPoolCreateInfo queryPoolInfo;
+        queryPoolInfo.queryType = vk::QueryType::eTimestamp;
+        queryPoolInfo.queryCount = 2 * _maxRegions;
+        _frames.resize(framesInFlight);
+        for (auto& frame : _frames) {
+            frame.queryPool = _pDevice->device().createQueryPool(queryPoolInfo);
+        }
+    } catch (std::exception& e) {
+        std::cerr << "Error while creating query pool : " << e.what() << '\n';
+        exit(-1);
+    }
+}
+
+void GpuProfiler::collect(FrameQueries& frame) {
+    uint32_t queryCount = 2 * (uint32_t)frame.regionNames.size();
+    if (queryCount == 0) return;
+    // every query is followed by its availability, a region missing either timestamp is dropped
+    // rather than waited on
+    const vk::DeviceSize stride = 2 * sizeof(uint64_t);
+    auto [result, data] = frame.queryPool.getResults<uint64_t>(
+        0, queryCount, queryCount * stride, stride,
+        vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWithAvailability);
+    if (result != vk::Result::eSuccess && result != vk::Result::eNotReady) return;
+
+    uint64_t frameBegin = ~0ull;
+    uint64_t frameEnd = 0;
+    for (size_t region = 0; region < frame.regionNames.size(); region++) {
+        size_t begin = 4 * region;
+        size_t end = begin + 2;
+        if (data[begin + 1] == 0 || data[end + 1] == 0) continue;
+        uint64_t beginTicks = data[begin] & _timestampMask;
+        uint64_t endTicks = data[end] & _timestampMask;
+        double seconds = ((endTicks - beginTicks) & _timestampMask) * _timestampPeriod * 1e-9;
+
+        auto& samples = _regionSamples[frame.regionNames[region]];
+        samples.push_back(seconds);
+        if (samples.size() > _maxSamples) samples.pop_front();
+        _windowSamples[frame.regionNames[region]].push_back(seconds);
+
+        frameBegin = std::min(frameBegin, beginTicks);
+        frameEnd = std::max(frameEnd, endTicks);
+    }
+    if (frameEnd >= frameBegin && frameEnd != 0) {
+        _lastFrameTime = ((frameEnd - frameBegin) & _timestampMask) * _timestampPeriod * 1e-9;
+    }
+}
+
+void GpuProfiler::beginFrame(const vk::raii::CommandBuffer& commandBuffer, uint32_t frameIndex) {
+    if (!_supported) return;
+    _currentFrame = frameIndex;
+    FrameQueries& frame = _frames.at(frameIndex);
+    collect(frame);
+    frame.regionNames.clear();
+    commandBuffer.resetQueryPool(*frame.queryPool, 0, 2 * _maxRegions);
+}
+
+int32_t GpuProfiler::beginRegion(const vk::raii::CommandBuffer& commandBuffer, const char* name) {
+    if (!_supported) return -1;
+    FrameQueries& frame = _frames[_currentFrame];
+    if (frame.regionNames.size() >= _maxRegions) return -1;
+    int32_t region = (int32_t)frame.regionNames.size();
+    frame.regionNames.push_back(name);
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, *frame.queryPool,
+                                 2 * region);
+    return region;
+}
+
+void GpuProfiler::endRegion(const vk::raii::CommandBuffer& commandBuffer, int32_t region) {
+    if (region < 0) return;
+    FrameQueries& frame = _frames[_currentFrame];
+    commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, *frame.queryPool,
+                                 2 * region + 1);
+}
+
+void GpuProfiler::printReport(std::ostream& os) {
+    if (!_supported || _windowSamples.empty()) return;
+    os << "GPU TIMES :\n";
+    for (auto& [name, samples] : _windowSamples) {
+        printTimingSummary(os, name.c_str(), FrameTimer::summarize(samples));
+    }
+    _windowSamples.clear();
+}
+
+void GpuProfiler::writeJson(JsonWriter& writer) const {
+    writer.beginObject();
+    writer.key("supported").value(_supported);
+    writer.key("timestamp_period_ns").value(_timestampPeriod);
+    writer.key("regions").beginObject();
+    for (const auto& [name, samples] : _regionSamples) {
+        writer.key(name);
+        writeTimingSummaryJson(writer,
+                               FrameTimer::summarize(std::vector<double>(samples.begin(),
+                                                                         samples.end())));
+    }
+    writer.endObject();
+    writer.endObject();
+}
+} // namespace render
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include <deque>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "device.hh"
+#include "json_writer.hh"
+
+namespace render {
+// Timestamp queries around regions of the frame command buffers. Each frame in flight has its own
+// query pool, its results are read back without waiting the next time the slot is reused, once
+// the frame's timeline value has been waited on.
+class GpuProfiler {
+public:
+    class Scope {
+    private:
+        GpuProfiler& _profiler;
+        const vk::raii::CommandBuffer& _commandBuffer;
+        int32_t _region;
+
+    public:
+        Scope(GpuProfiler& profiler, const vk::raii::CommandBuffer& commandBuffer,
+              const char* name);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+private:
+    struct FrameQueries {
+        vk::raii::QueryPool queryPool = 0;
+        std::vector<const char*> regionNames;
+    };
+
+    std::shared_ptr<const render::Device> _pDevice;
+    uint32_t _maxRegions;
+    bool _supported = false;
+    double _timestampPeriod = 1.0; // nanoseconds per tick
+    uint64_t _timestampMask = ~0ull;
+    std::vector<FrameQueries> _frames;
+    uint32_t _currentFrame = 0;
+    double _lastFrameTime = -1.0;
+    size_t _maxSamples;
+    std::map<std::string, std::deque<double>> _regionSamples; // last maxSamples per region
+    std::map<std::string, std::vector<double>> _windowSamples; // since the last report
+
+    void createQueryPools(uint32_t framesInFlight);
+    void collect(FrameQueries& frame);
+    int32_t beginRegion(const vk::raii::CommandBuffer& commandBuffer, const char* name);
+    void endRegion(const vk::raii::CommandBuffer& commandBuffer, int32_t region);
+
+public:
+    GpuProfiler(std::shared_ptr<const render::Device> pDevice, uint32_t framesInFlight,
+                uint32_t maxRegions = 32, size_t maxSamples = 4096);
+
+    // Reads back the results of the previous use of the slot then resets its queries, must be
+    // recorded outside of a render pass after the frame's timeline value was waited on
+    void beginFrame(const vk::raii::CommandBuffer& commandBuffer, uint32_t frameIndex);
+
+    bool supported() const {
+        return _supported;
+    }
+    // Span between the first and the last timestamp of the most recently resolved frame, in
+    // seconds, negative when no frame was resolved yet
+    double lastFrameTime() const {
+        return _lastFrameTime;
+    }
+
+    // Prints the regions resolved since the previous report
+    void printReport(std::ostream& os);
+    void writeJson(JsonWriter& writer) const;
+};
+} // namespace render
\ No newline at end of file
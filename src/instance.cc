@@ -7,6 +7,21 @@
 namespace render {
 uint GLFWContext::_instancingCount = 0;
 
+bool Instance::validationLayersSupported() const {
+    auto availableLayers = _context.enumerateInstanceLayerProperties();
+    for (const char* layerName : validationLayers) {
+        bool found = false;
+        for (const auto& layer : availableLayers) {
+            if (std::string(layer.layerName.data()) == layerName) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) return false;
+    }
+    return true;
+}
+
 void Instance::createInstance() {
     try {
         vk::ApplicationInfo appInfo{};
@@ -19,24 +34,23 @@ void Instance::createInstance() {
         vk::InstanceCreateInfo instanceCreateInfo;
         instanceCreateInfo.pApplicationInfo = &appInfo;
 
-        uint32_t glfwExtensionCount = 0;
-        const char** glfwExtensions;
-        glfwExtensions = glfwGetRequiredInstanceExtensions(
-            &glfwExtensionCount); // we should check that they are supported
-        std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
-#ifndef NDEBUG
-        extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME); // we should check that they are
-                                                                 // supported
-#endif
-        instanceCreateInfo.setPEnabledExtensionNames(extensions);
-
-#ifndef NDEBUG
-        // we should check here that the validation layers are supported
-        instanceCreateInfo.setPEnabledLayerNames(validationLayers);
+        std::vector<const char*> extensions;
+        if (!_headless) {
+            uint32_t glfwExtensionCount = 0;
+            const char** glfwExtensions;
+            glfwExtensions = glfwGetRequiredInstanceExtensions(
+                &glfwExtensionCount); // we should check that they are supported
+            extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        }
         vk::DebugUtilsMessengerCreateInfoEXT debugUtilsMessengerCreateInfoEXT =
             getDebugUtilsMessengerCreateInfoEXT();
-        instanceCreateInfo.pNext = &debugUtilsMessengerCreateInfoEXT;
-#endif
+        if (_validationEnabled) {
+            extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME); // provided by the layer
+            instanceCreateInfo.setPEnabledLayerNames(validationLayers);
+            instanceCreateInfo.pNext = &debugUtilsMessengerCreateInfoEXT;
+        }
+        instanceCreateInfo.setPEnabledExtensionNames(extensions);
+
         _instance = _context.createInstance(instanceCreateInfo);
     } catch (std::exception& e) {
         std::cerr << "Error while creating instance : " << e.what() << '\n';
@@ -85,9 +99,21 @@ vk::DebugUtilsMessengerCreateInfoEXT Instance::getDebugUtilsMessengerCreateInfoE
     return instanceDebugUtilsMessengerCreateInfoEXT;
 }
 
-Instance::Instance() {
+Instance::Instance(bool headless) : _headless(headless) {
+    if (!_headless) {
+        _glfwContext.emplace();
+    }
+#ifndef NDEBUG
+    // containers and build machines often lack the SDK layers, run without them there
+    _validationEnabled = validationLayersSupported();
+    if (!_validationEnabled) {
+        std::cout << "Validation layers are not available, continuing without them\n";
+    }
+#endif
     createInstance();
-    createDebugUtilsMessenger();
+    if (_validationEnabled) {
+        createDebugUtilsMessenger();
+    }
 }
 
 } // namespace render
\ No newline at end of file
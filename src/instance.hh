@@ -3,6 +3,7 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include <vulkan/vulkan_raii.hpp>
+#include <optional>
 
 const std::vector<const char*> validationLayers = {"VK_LAYER_KHRONOS_validation"};
 
@@ -28,22 +29,32 @@ private:
 
 class Instance {
 private:
-    GLFWContext _glfwContext;
+    std::optional<GLFWContext> _glfwContext;
+    bool _headless;
+    bool _validationEnabled = false;
     vk::raii::Context _context;
     vk::raii::Instance _instance = 0;
     vk::raii::DebugUtilsMessengerEXT _debugUtilsMessenger = 0;
 
+    bool validationLayersSupported() const;
     void createInstance();
     void createDebugUtilsMessenger();
     vk::DebugUtilsMessengerCreateInfoEXT getDebugUtilsMessengerCreateInfoEXT() const;
 
 public:
-    Instance();
+    // A headless instance neither initializes GLFW nor enables the surface extensions
+    Instance(bool headless = false);
     operator const vk::raii::Instance&() const {
         return _instance;
     }
     const vk::raii::Instance& instance() const {
         return _instance;
     }
+    bool headless() const {
+        return _headless;
+    }
+    bool validationEnabled() const {
+        return _validationEnabled;
+    }
 };
 } // namespace render
\ No newline at end of file
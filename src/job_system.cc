@@ -0,0 +1,235 @@
+#include "job_system.hh"
+
+#include <algorithm>
+#include <iomanip>
+#include <string>
+#include <utility>
+
+#include "trace.hh"
+
+namespace render {
+// failed searches for a job before a waiting thread goes to sleep
+constexpr uint32_t WAIT_SPINS = 64;
+
+namespace {
+thread_local const JobSystem* tlsJobSystem = nullptr;
+thread_local uint32_t tlsQueueIndex = 0;
+thread_local uint32_t tlsJobDepth = 0; // jobs run while waiting inside a job are nested
+} // namespace
+
+void JobStats::print(std::ostream& os) const {
+    std::ios_base::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << "JOBS : " << workers << " workers, " << jobs << " jobs (" << steals << " stolen), "
+       << helpedJobs << " run while waiting, " << std::fixed << std::setprecision(1)
+       << 100.0 * utilization() << "% utilization, " << 100.0 * overhead()
+       << "% scheduling overhead\n";
+    os.flags(flags);
+    os.precision(precision);
+}
+
+void JobStats::writeJson(JsonWriter& writer) const {
+    writer.beginObject();
+    writer.key("workers").value(workers);
+    writer.key("jobs").value(jobs);
+    writer.key("helped_jobs").value(helpedJobs);
+    writer.key("steals").value(steals);
+    writer.key("elapsed_s").value(elapsed);
+    writer.key("busy_s").value(busy);
+    writer.key("scheduling_s").value(scheduling);
+    writer.key("utilization").value(utilization());
+    writer.key("overhead").value(overhead());
+    writer.endObject();
+}
+
+uint32_t JobSystem::defaultWorkerCount() {
+    uint32_t cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 0;
+}
+
+JobSystem::JobSystem(uint32_t workerCount) : _startNs(Tracer::now()) {
+    for (uint32_t i = 0; i <= workerCount; i++) {
+        _queues.push_back(std::make_unique<WorkerQueue>());
+        _stats.push_back(std::make_unique<WorkerStats>());
+    }
+    for (uint32_t i = 1; i <= workerCount; i++) {
+        _threads.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _stopping = true;
+    }
+    _wakeUp.notify_all();
+    for (std::thread& thread : _threads) thread.join();
+}
+
+uint32_t JobSystem::queueIndex() const {
+    return tlsJobSystem == this ? tlsQueueIndex : 0;
+}
+
+void JobSystem::push(Job job) {
+    {
+        WorkerQueue& queue = *_queues[queueIndex()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(std::move(job));
+        // counted under the queue lock, a thief taking the job right away cannot decrement first
+        _queued.fetch_add(1);
+    }
+    // a worker going to sleep counts itself before checking the queued jobs, one of the two
+    // sides sees the other
+    if (_sleeping.load() > 0) {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _wakeUp.notify_one();
+    }
+}
+
+bool JobSystem::findJob(uint32_t index, Job& job) {
+    {
+        WorkerQueue& queue = *_queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty()) {
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+            _queued.fetch_sub(1);
+            return true;
+        }
+    }
+    if (_queued.load() == 0) return false;
+    for (size_t i = 1; i < _queues.size(); i++) {
+        WorkerQueue& victim = *_queues[(index + i) % _queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.jobs.empty()) continue;
+        job = std::move(victim.jobs.front());
+        victim.jobs.pop_front();
+        _queued.fetch_sub(1);
+        _stats[index]->steals.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void JobSystem::execute(Job& job, uint32_t index) {
+    uint64_t start = Tracer::now();
+    bool outermost = tlsJobDepth++ == 0;
+    job.function();
+    tlsJobDepth--;
+    WorkerStats& stats = *_stats[index];
+    if (outermost) stats.busyNs.fetch_add(Tracer::now() - start, std::memory_order_relaxed);
+    stats.jobs.fetch_add(1, std::memory_order_relaxed);
+    complete(*job.pCounter);
+}
+
+void JobSystem::complete(JobCounter& counter) {
+    std::vector<std::function<void()>> continuations;
+    bool done = false;
+    {
+        std::lock_guard<std::mutex> lock(counter._mutex);
+        // sequentially consistent with the waiters counting themselves before checking it
+        if (counter._pending.fetch_sub(1) == 1) {
+            continuations.swap(counter._continuations);
+            done = true;
+        }
+    }
+    // the counter may be gone from here on
+    if (done && _waiting.load() > 0) {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _wakeUp.notify_all();
+    }
+    for (auto& continuation : continuations) continuation();
+}
+
+void JobSystem::workerLoop(uint32_t index) {
+    tlsJobSystem = this;
+    tlsQueueIndex = index;
+    if (Tracer::enabled()) Tracer::setThreadName("job worker " + std::to_string(index));
+    WorkerStats& stats = *_stats[index];
+    while (true) {
+        uint64_t searchStart = Tracer::now();
+        Job job;
+        if (findJob(index, job)) {
+            stats.schedulingNs.fetch_add(Tracer::now() - searchStart, std::memory_order_relaxed);
+            execute(job, index);
+            continue;
+        }
+        stats.schedulingNs.fetch_add(Tracer::now() - searchStart, std::memory_order_relaxed);
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _sleeping.fetch_add(1);
+        _wakeUp.wait(lock, [&] { return _stopping || _queued.load() > 0; });
+        _sleeping.fetch_sub(1);
+        if (_stopping) return;
+    }
+}
+
+void JobSystem::run(std::function<void()> function, JobCounter& counter,
+                    JobCounter* pDependency) {
+    counter._pending.fetch_add(1, std::memory_order_relaxed);
+    Job job{std::move(function), &counter};
+    if (pDependency) {
+        std::lock_guard<std::mutex> lock(pDependency->_mutex);
+        if (!pDependency->done()) {
+            pDependency->_continuations.push_back([this, job]() { push(job); });
+            return;
+        }
+    }
+    push(std::move(job));
+}
+
+void JobSystem::parallelFor(size_t count, size_t grain,
+                            std::function<void(size_t, size_t)> function, JobCounter& counter) {
+    if (count == 0) return;
+    grain = std::max<size_t>(grain, 1);
+    size_t rangeCount = std::min<size_t>((count + grain - 1) / grain, threadCount());
+    auto pFunction = std::make_shared<std::function<void(size_t, size_t)>>(std::move(function));
+    for (size_t range = 0; range < rangeCount; range++) {
+        size_t begin = count * range / rangeCount;
+        size_t end = count * (range + 1) / rangeCount;
+        run([pFunction, begin, end]() { (*pFunction)(begin, end); }, counter);
+    }
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    uint32_t index = queueIndex();
+    uint32_t misses = 0;
+    while (!counter.done()) {
+        Job job;
+        if (findJob(index, job)) {
+            execute(job, index);
+            misses = 0;
+        } else if (++misses < WAIT_SPINS) {
+            std::this_thread::yield();
+        } else {
+            // the last jobs run on other threads
+            std::unique_lock<std::mutex> lock(_sleepMutex);
+            _sleeping.fetch_add(1);
+            _waiting.fetch_add(1);
+            _wakeUp.wait(lock, [&] { return counter._pending.load() == 0 || _queued.load() > 0; });
+            _waiting.fetch_sub(1);
+            _sleeping.fetch_sub(1);
+            misses = 0;
+        }
+    }
+    // the last job may still be releasing the counter
+    std::lock_guard<std::mutex> lock(counter._mutex);
+}
+
+JobStats JobSystem::stats() const {
+    JobStats stats;
+    stats.workers = workerCount();
+    stats.elapsed = (Tracer::now() - _startNs) * 1e-9;
+    for (size_t i = 0; i < _stats.size(); i++) {
+        const WorkerStats& worker = *_stats[i];
+        stats.steals += worker.steals.load(std::memory_order_relaxed);
+        if (i == 0) {
+            stats.helpedJobs = worker.jobs.load(std::memory_order_relaxed);
+            continue;
+        }
+        stats.jobs += worker.jobs.load(std::memory_order_relaxed);
+        stats.busy += worker.busyNs.load(std::memory_order_relaxed) * 1e-9;
+        stats.scheduling += worker.schedulingNs.load(std::memory_order_relaxed) * 1e-9;
+    }
+    return stats;
+}
+} // namespace render
\ No newline at end of file
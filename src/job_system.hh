@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include "json_writer.hh"
+
+namespace render {
+struct JobStats {
+    uint32_t workers = 0;
+    uint64_t jobs = 0;        // executed by the workers
+    uint64_t helpedJobs = 0;  // executed by threads waiting on a counter
+    uint64_t steals = 0;
+    double elapsed = 0.0;     // seconds since the scheduler started
+    double busy = 0.0;        // seconds in jobs, summed over the workers
+    double scheduling = 0.0;  // seconds looking for jobs without sleeping, summed over the workers
+
+    // Share of the worker time spent in jobs
+    double utilization() const {
+        return elapsed > 0.0 && workers > 0 ? busy / (elapsed * workers) : 0.0;
+    }
+    // Share of the awake worker time spent in the scheduler rather than in jobs
+    double overhead() const {
+        return busy + scheduling > 0.0 ? scheduling / (busy + scheduling) : 0.0;
+    }
+    void print(std::ostream& os) const;
+    void writeJson(JsonWriter& writer) const;
+};
+
+// Jobs left in a group. Jobs can be queued to run once a counter reaches zero, a counter must
+// outlive its jobs and can be reused once waited on.
+class JobCounter {
+private:
+    friend class JobSystem;
+    std::atomic<uint32_t> _pending{0};
+    std::mutex _mutex; // taken by the last decrement and to queue continuations
+    std::vector<std::function<void()>> _continuations;
+
+public:
+    JobCounter() = default;
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool done() const {
+        return _pending.load(std::memory_order_acquire) == 0;
+    }
+};
+
+// Work-stealing scheduler. Every worker owns a deque it pushes to and pops from at the back, idle
+// workers steal the oldest jobs at the front of the others. Threads the scheduler does not own,
+// such as the main thread, share an extra deque. Waiting on a counter runs queued jobs instead
+// of blocking, so jobs can wait on other jobs. Once there is nothing left to run the waiter
+// sleeps until the counter reaches zero or new jobs are queued.
+class JobSystem {
+private:
+    struct Job {
+        std::function<void()> function;
+        JobCounter* pCounter;
+    };
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+    struct WorkerStats {
+        std::atomic<uint64_t> jobs{0};
+        std::atomic<uint64_t> steals{0};
+        std::atomic<uint64_t> busyNs{0};
+        std::atomic<uint64_t> schedulingNs{0};
+    };
+
+    // index 0 belongs to the threads not owned by the scheduler, the workers use the others
+    std::vector<std::unique_ptr<WorkerQueue>> _queues;
+    std::vector<std::unique_ptr<WorkerStats>> _stats;
+    std::vector<std::thread> _threads;
+    std::atomic<uint64_t> _queued{0};
+    std::atomic<uint32_t> _sleeping{0}; // workers and waiters blocked on _wakeUp
+    std::atomic<uint32_t> _waiting{0};  // waiters only, woken when a counter reaches zero
+    std::mutex _sleepMutex;
+    std::condition_variable _wakeUp;
+    bool _stopping = false;
+    uint64_t _startNs;
+
+    uint32_t queueIndex() const;
+    void push(Job job);
+    bool findJob(uint32_t index, Job& job);
+    void execute(Job& job, uint32_t index);
+    void complete(JobCounter& counter);
+    void workerLoop(uint32_t index);
+
+public:
+    // 0 workers runs every job on the waiting threads
+    explicit JobSystem(uint32_t workerCount);
+    ~JobSystem();
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Queues a job counted by the counter, held back until the dependency reaches zero
+    void run(std::function<void()> function, JobCounter& counter,
+             JobCounter* pDependency = nullptr);
+    // Splits [0, count) into ranges of at least grain items, at most one per thread
+    void parallelFor(size_t count, size_t grain, std::function<void(size_t, size_t)> function,
+                     JobCounter& counter);
+    // Runs queued jobs until the counter reaches zero, can be called from any thread and from
+    // jobs
+    void wait(JobCounter& counter);
+
+    uint32_t workerCount() const {
+        return (uint32_t)_threads.size();
+    }
+    // Workers and the waiting thread
+    uint32_t threadCount() const {
+        return workerCount() + 1;
+    }
+    JobStats stats() const;
+
+    // One worker per core besides the calling thread
+    static uint32_t defaultWorkerCount();
+};
+} // namespace render
\ No newline at end of file
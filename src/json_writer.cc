@@ -0,0 +1,138 @@
+#include "json_writer.hh"
+
+#include <cmath>
+#include <iomanip>
+
+namespace render {
+JsonWriter::JsonWriter(std::ostream& os) : _os(os) {
+}
+
+void JsonWriter::separate() {
+    if (_afterKey) {
+        _afterKey = false;
+        return;
+    }
+    if (!_firstInScope.empty()) {
+        if (!_firstInScope.back()) _os << ',';
+        _firstInScope.back() = false;
+    }
+}
+
+void JsonWriter::writeString(const std::string& str) {
+    _os << '"';
+    for (char c : str) {
+        switch (c) {
+            case '"':
+                _os << "\\\"";
+                break;
+            case '\\':
+                _os << "\\\\";
+                break;
+            case '\n':
+                _os << "\\n";
+                break;
+            case '\t':
+                _os << "\\t";
+                break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    _os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c
+                        << std::dec << std::setfill(' ');
+                } else {
+                    _os << c;
+                }
+        }
+    }
+    _os << '"';
+}
+
+JsonWriter& JsonWriter::beginObject() {
+    separate();
+    _os << '{';
+    _firstInScope.push_back(true);
+    return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+    _firstInScope.pop_back();
+    _os << '}';
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray() {
+    separate();
+    _os << '[';
+    _firstInScope.push_back(true);
+    return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+    _firstInScope.pop_back();
+    _os << ']';
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(const std::string& name) {
+    separate();
+    writeString(name);
+    _os << ':';
+    _afterKey = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(const std::string& str) {
+    separate();
+    writeString(str);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(const char* str) {
+    return value(std::string(str));
+}
+
+JsonWriter& JsonWriter::value(double number) {
+    separate();
+    if (std::isfinite(number)) {
+        _os << std::setprecision(15) << number;
+    } else {
+        _os << "null"; // JSON has no representation for inf and nan
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(int number) {
+    separate();
+    _os << number;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(uint32_t number) {
+    separate();
+    _os << number;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(int64_t number) {
+    separate();
+    _os << number;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(uint64_t number) {
+    separate();
+    _os << number;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(bool boolean) {
+    separate();
+    _os << (boolean ? "true" : "false");
+    return *this;
+}
+
+JsonWriter& JsonWriter::raw(const std::string& json) {
+    separate();
+    _os << json;
+    return *this;
+}
+} // namespace render
\ No newline at end of file
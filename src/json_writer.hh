@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace render {
+// Streaming JSON writer, just enough for the stats and trace dumps.
+class JsonWriter {
+private:
+    std::ostream& _os;
+    std::vector<bool> _firstInScope;
+    bool _afterKey = false;
+
+    void separate();
+    void writeString(const std::string& str);
+
+public:
+    JsonWriter(std::ostream& os);
+
+    JsonWriter& beginObject();
+    JsonWriter& endObject();
+    JsonWriter& beginArray();
+    JsonWriter& endArray();
+    JsonWriter& key(const std::string& name);
+    JsonWriter& value(const std::string& str);
+    JsonWriter& value(const char* str);
+    JsonWriter& value(double number);
+    JsonWriter& value(int number);
+    JsonWriter& value(uint32_t number);
+    JsonWriter& value(int64_t number);
+    JsonWriter& value(uint64_t number);
+    JsonWriter& value(bool boolean);
+    // Inserts an already serialized JSON value as is
+    JsonWriter& raw(const std::string& json);
+};
+} // namespace render
\ No newline at end of file
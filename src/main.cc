@@ -1,134 +1,144 @@
 #include <vulkan/vulkan_raii.hpp>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <fstream>
 #include <memory>
+#include <optional>
 
 #include "instance.hh"
 #include "display.hh"
 #include "device.hh"
 #include "swap_chain.hh"
-#include "pipeline.hh"
-#include "buffer.hh"
-
-int main(void) {
-    std::shared_ptr<render::Instance> pInstance = std::make_shared<render::Instance>();
-    std::shared_ptr<render::Display> pDisplay = std::make_shared<render::Display>(pInstance, "window", 800, 450);
-
-    std::shared_ptr<render::Device> pDevice = std::make_shared<render::Device>(pInstance, pDisplay->surface());
-    std::shared_ptr<render::SwapChain> pSwapChain = std::make_shared<render::SwapChain>(pDisplay, pDevice);
-
-    std::shared_ptr<render::Pipeline> pPipeline = std::make_shared<render::Pipeline>(pDevice, pSwapChain);
+#include "offscreen_target.hh"
+#include "scene.hh"
+#include "renderer.hh"
+#include "render_thread.hh"
+#include "frame_pacer.hh"
+#include "frame_timer.hh"
+#include "json_writer.hh"
+#include "trace.hh"
+#include "options.hh"
+
+// seconds between two periodic frame time reports
+constexpr double REPORT_INTERVAL = 5.0;
+// longest wait for window events before publishing a new snapshot, in seconds
+constexpr double APPLICATION_TICK = 1.0 / 240.0;
+// radians per second of the color pulse, about the rate of the frame driven one at 60 Hz
+constexpr double PULSE_RATE = 3.0;
+
+int main(int argc, char** argv) {
+    render::Options options = render::parseOptions(argc, argv);
+    if (!options.tracePath.empty()) {
+        render::Tracer::enable();
+        render::Tracer::setThreadName("main");
+    }
+    if (!options.tracePath.empty() || !options.allocatorDumpPath.empty()) {
+        std::signal(SIGUSR1, [](int) { render::Tracer::requestDump(); });
+    }
 
-    std::vector<VertexBasic> vertices = {{{0.8, -0.8, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0}},
-                                         {{-0.8, -0.8, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0}},
-                                         {{-0.8, 0.8, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0}},
-                                         {{0.8, 0.8, 0.8}, {0.0, 0.0, 0.0}, {0.0, 0.0}}
+    std::shared_ptr<render::FramePacer> pPacer =
+        std::make_shared<render::FramePacer>(options.pacingPolicy, options.targetFps);
+
+    render::DevicePreference devicePreference = render::DevicePreference::fromEnvironment();
+    if (!options.deviceSelector.empty()) devicePreference.selector = options.deviceSelector;
+    devicePreference.sharingMode = options.sharingMode;
+    devicePreference.jobWorkers = options.jobWorkers;
+
+    std::shared_ptr<render::Instance> pInstance =
+        std::make_shared<render::Instance>(options.headless);
+    std::shared_ptr<render::Display> pDisplay;
+    std::shared_ptr<render::Device> pDevice;
+    std::shared_ptr<render::OffscreenTarget> pOffscreenTarget;
+    std::shared_ptr<render::RenderTarget> pTarget;
+    if (options.headless) {
+        pDevice = std::make_shared<render::Device>(pInstance, devicePreference);
+        pOffscreenTarget = std::make_shared<render::OffscreenTarget>(
+            pDevice, vk::Extent2D{options.width, options.height}, options.framesInFlight);
+        pTarget = pOffscreenTarget;
+    } else {
+        pDisplay = std::make_shared<render::Display>(pInstance, "window", options.width,
+                                                     options.height);
+        pDevice =
+            std::make_shared<render::Device>(pInstance, pDisplay->surface(), devicePreference);
+        pTarget = std::make_shared<render::SwapChain>(pDisplay, pDevice,
+                                                      pPacer->preferredPresentMode());
+    }
 
+    std::shared_ptr<render::Scene> pScene =
+        std::make_shared<render::Scene>(pDevice, render::SceneParameters{});
+    render::Renderer renderer(pDevice, pTarget, pScene, pPacer, options.framesInFlight,
+                              options.recordThreads, options.staticCommands);
+    render::FrameTimer& frameTimer = renderer.frameTimer();
+
+    // dumps and periodic reports run on the thread rendering, between two frames
+    auto afterFrame = [&]() {
+        if (render::Tracer::consumeDumpRequest()) {
+            if (!options.tracePath.empty()) render::Tracer::writeChromeTrace(options.tracePath);
+            if (!options.allocatorDumpPath.empty()) {
+                renderer.memoryMonitor().writeAllocatorDump(options.allocatorDumpPath);
+            }
+        }
+        if (frameTimer.reportDue(REPORT_INTERVAL)) {
+            frameTimer.printReport(std::cout);
+            renderer.gpuProfiler().printReport(std::cout);
+            renderer.memoryMonitor().printReport(std::cout);
+        }
     };
 
-    std::vector<uint32_t> indices = {0, 1, 2, 0, 2, 3};
-
-    render::Buffer vertexBuffer = render::Buffer(*pDevice, sizeof(VertexBasic) * vertices.size(),
-                                                 VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-    vertexBuffer.mapData(*pDevice, vertices.data(), sizeof(VertexBasic) * vertices.size());
-
-    render::Buffer indexBuffer =
-        render::Buffer(*pDevice, sizeof(uint32_t) * indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
-    indexBuffer.mapData(*pDevice, indices.data(), sizeof(uint32_t) * indices.size());
-
-    vk::raii::Semaphore imageAvailableSemaphore = 0;
-    vk::raii::Semaphore renderFinishedSemaphore = 0;
-    vk::raii::Fence inFlightFence = 0;
-    try {
-        vk::SemaphoreCreateInfo semaphoreInfo;
-        imageAvailableSemaphore = pDevice->device().createSemaphore(semaphoreInfo);
-        renderFinishedSemaphore = pDevice->device().createSemaphore(semaphoreInfo);
-
-        vk::FenceCreateInfo fenceInfo;
-        fenceInfo.flags = vk::FenceCreateFlagBits::eSignaled;
-        inFlightFence = pDevice->device().createFence(fenceInfo);
-    } catch (std::exception& e) {
-        std::cerr << "Error while creating sync elements : " << e.what() << '\n';
-        exit(-1);
-    }
-
     // Main loop
-    while (!glfwWindowShouldClose(pDisplay->pWindow())) {
-        static double lastFrameTime = glfwGetTime();
-        double currentTime = glfwGetTime();
-        double deltaTime = currentTime - lastFrameTime;
-        if (deltaTime < (1.0 / 60.0)) {
-            continue;
+    std::optional<render::HandoffStats> handoffStats;
+    if (options.headless) {
+        for (uint64_t frameCount = 0; frameCount < options.frameCount; frameCount++) {
+            frameTimer.beginFrame();
+            renderer.renderFrame();
+            frameTimer.endFrame();
+            afterFrame();
         }
-        lastFrameTime = currentTime;
-        // FPS counter
-        {
-            static int counter = 0;
-            static double timeRef = 0.0;
-            counter++;
-            timeRef += deltaTime;
-            if (timeRef > 5.0) {
-                double framerate = counter / timeRef;
-                std::cout << "FRAMERATE : " << framerate << " fps\n";
-                counter = 0;
-                timeRef = 0.0;
-            }
+        renderer.waitIdle();
+    } else {
+        // the main thread keeps the window and its events, the render thread submits and
+        // presents, neither waits on the other
+        GLFWwindow* pWindow = pDisplay->pWindow();
+        render::RenderThread renderThread(renderer, options.frameCount, afterFrame,
+                                          []() { glfwPostEmptyEvent(); });
+        auto start = std::chrono::steady_clock::now();
+        while (!glfwWindowShouldClose(pWindow) && !renderThread.finished()) {
+            glfwWaitEventsTimeout(APPLICATION_TICK);
+            render::FrameSnapshot& snapshot = renderThread.snapshot();
+            snapshot.time =
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            snapshot.pulse = 0.75f + 0.25f * (float)std::sin(snapshot.time * PULSE_RATE);
+            glfwGetCursorPos(pWindow, &snapshot.cursorX, &snapshot.cursorY);
+            renderThread.publish();
         }
-        auto result = pDevice->device().waitForFences(*inFlightFence, true, UINT_FAST64_MAX);
-        pDevice->device().resetFences(*inFlightFence);
-        uint32_t imageIndex =
-            pSwapChain->swapChain()
-                .acquireNextImage(UINT_FAST64_MAX, *imageAvailableSemaphore, nullptr)
-                .second;
-        pDevice->graphicsCommandBuffer().reset();
-
-        vk::CommandBufferBeginInfo beginInfo;
-        pDevice->graphicsCommandBuffer().begin(beginInfo);
-        vk::RenderPassBeginInfo renderPassInfo;
-        renderPassInfo.renderPass = *pPipeline->renderPass();
-        renderPassInfo.framebuffer = *pPipeline->framebuffers()[imageIndex];
-        renderPassInfo.renderArea.offset = vk::Offset2D{0, 0};
-        renderPassInfo.renderArea.extent = pSwapChain->extent();
-        vk::ClearValue clearValue = vk::ClearValue{{0.0f, 0.0f, 0.0f, 1.0f}};
-        renderPassInfo.setClearValues(clearValue);
-        pDevice->graphicsCommandBuffer().beginRenderPass(renderPassInfo,
-                                                       vk::SubpassContents::eInline);
-        pDevice->graphicsCommandBuffer().bindPipeline(vk::PipelineBindPoint::eGraphics,
-                                                    *pPipeline->pipeline());
-        pDevice->graphicsCommandBuffer().bindVertexBuffers(0, {vertexBuffer.buffer()}, {0});
-        pDevice->graphicsCommandBuffer().bindIndexBuffer(indexBuffer.buffer(), 0, vk::IndexType::eUint32);
-
-        vk::Viewport viewport;
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = static_cast<float>(pSwapChain->extent().width);
-        viewport.height = static_cast<float>(pSwapChain->extent().height);
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-        pDevice->graphicsCommandBuffer().setViewport(0, viewport);
-
-        vk::Rect2D scissor;
-        scissor.offset = vk::Offset2D{0, 0};
-        scissor.extent = pSwapChain->extent();
-        pDevice->graphicsCommandBuffer().setScissor(0, scissor);
-
-        pDevice->graphicsCommandBuffer().drawIndexed((uint32_t)indices.size(), 1, 0, 0, 0);
-        pDevice->graphicsCommandBuffer().endRenderPass();
-        pDevice->graphicsCommandBuffer().end();
-
-        vk::SubmitInfo submitInfo;
-        submitInfo.setWaitSemaphores(*imageAvailableSemaphore);
-        vk::PipelineStageFlags waitStages = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-        submitInfo.setWaitDstStageMask(waitStages);
-        submitInfo.setCommandBuffers(*pDevice->graphicsCommandBuffer());
-        submitInfo.setSignalSemaphores(*renderFinishedSemaphore);
-        pDevice->graphicsQueue().submit(submitInfo, *inFlightFence);
-
-        vk::PresentInfoKHR presentInfo;
-        presentInfo.setWaitSemaphores(*renderFinishedSemaphore);
-        presentInfo.setSwapchains(*pSwapChain->swapChain());
-        presentInfo.setImageIndices(imageIndex);
-        pDevice->graphicsQueue().presentKHR(presentInfo);
-
-        glfwPollEvents();
+        renderThread.stop();
+        handoffStats = renderThread.stats();
+    }
+    frameTimer.printSummary(std::cout);
+    if (handoffStats) handoffStats->print(std::cout);
+    renderer.gpuProfiler().printReport(std::cout);
+    pDevice->uploadBatcher().stats().print(std::cout);
+    pDevice->deletionQueue().stats().print(std::cout);
+    pDevice->jobSystem().stats().print(std::cout);
+    pScene->geometryPool().printStats(std::cout);
+    renderer.memoryMonitor().printReport(std::cout);
+    renderer.defragmenter().printStats(std::cout);
+    if (renderer.staticCommands()) renderer.staticCommands()->stats().print(std::cout);
+    if (!options.statsPath.empty()) {
+        std::ofstream ofs(options.statsPath);
+        render::JsonWriter writer(ofs);
+        renderer.writeJson(writer);
+        ofs << '\n';
+        if (!ofs) std::cerr << "Error while writing " << options.statsPath << '\n';
+    }
+    if (!options.tracePath.empty()) {
+        render::Tracer::writeChromeTrace(options.tracePath);
+    }
+    if (!options.allocatorDumpPath.empty()) {
+        renderer.memoryMonitor().writeAllocatorDump(options.allocatorDumpPath);
+    }
+    if (pOffscreenTarget && !options.outputPath.empty()) {
+        pOffscreenTarget->writePpm(options.outputPath, pOffscreenTarget->lastImage());
     }
-    pDevice->device().waitIdle();
 }
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include "memory_monitor.hh"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "trace.hh"
+
+namespace render {
+// share of the budget above which a heap is reported under pressure
+constexpr double PRESSURE_RATIO = 0.9;
+
+static double toMiB(vk::DeviceSize bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+MemoryMonitor::MemoryMonitor(std::shared_ptr<const render::Device> pDevice) : _pDevice(pDevice) {
+    const VkPhysicalDeviceMemoryProperties* memoryProperties;
+    vmaGetMemoryProperties(_pDevice->allocator(), &memoryProperties);
+    _heaps.resize(memoryProperties->memoryHeapCount);
+    for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; i++) {
+        _heaps[i].size = memoryProperties->memoryHeaps[i].size;
+        _heaps[i].deviceLocal =
+            (memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    }
+    for (size_t i = 1; i < (size_t)MemoryPool::COUNT; i++) {
+        if (_pDevice->memoryPool((MemoryPool)i) != VK_NULL_HANDLE) {
+            _pools.push_back(PoolSample{(MemoryPool)i});
+        }
+    }
+}
+
+void MemoryMonitor::sample(uint32_t frameIndex) {
+    TRACE_SCOPE("MemoryMonitor::sample");
+    VmaAllocator allocator = _pDevice->allocator();
+    vmaSetCurrentFrameIndex(allocator, frameIndex);
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetHeapBudgets(allocator, budgets);
+    VmaTotalStatistics statistics;
+    vmaCalculateStatistics(allocator, &statistics);
+
+    bool underPressure = false;
+    for (size_t i = 0; i < _heaps.size(); i++) {
+        HeapSample& heap = _heaps[i];
+        heap.budget = budgets[i].budget;
+        heap.usage = budgets[i].usage;
+        heap.peakUsage = std::max(heap.peakUsage, heap.usage);
+        const VmaStatistics& heapStatistics = statistics.memoryHeap[i].statistics;
+        heap.blockCount = heapStatistics.blockCount;
+        heap.allocationCount = heapStatistics.allocationCount;
+        heap.blockBytes = heapStatistics.blockBytes;
+        heap.allocationBytes = heapStatistics.allocationBytes;
+        if (heap.budget != 0 && heap.usage > PRESSURE_RATIO * heap.budget) {
+            underPressure = true;
+            if (!_underPressure) {
+                std::cout << "Memory heap " << i << " uses " << (uint64_t)toMiB(heap.usage)
+                          << " MiB of its " << (uint64_t)toMiB(heap.budget) << " MiB budget\n";
+            }
+        }
+    }
+    for (PoolSample& pool : _pools) {
+        VmaStatistics poolStatistics;
+        vmaGetPoolStatistics(allocator, _pDevice->memoryPool(pool.pool), &poolStatistics);
+        pool.blockCount = poolStatistics.blockCount;
+        pool.allocationCount = poolStatistics.allocationCount;
+        pool.blockBytes = poolStatistics.blockBytes;
+        pool.allocationBytes = poolStatistics.allocationBytes;
+    }
+    if (underPressure) _pressureCount++;
+    _underPressure = underPressure;
+    _sampleCount++;
+}
+
+void MemoryMonitor::printReport(std::ostream& os) const {
+    if (_sampleCount == 0) return;
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(1);
+    os << "MEMORY : " << _sampleCount << " samples, " << _pressureCount << " under pressure";
+    if (!_pDevice->memoryBudgetSupported()) os << ", budgets estimated";
+    os << '\n';
+    for (size_t i = 0; i < _heaps.size(); i++) {
+        const HeapSample& heap = _heaps[i];
+        os << "  heap " << i << (heap.deviceLocal ? " (device local)" : "") << " : "
+           << toMiB(heap.usage) << " / " << toMiB(heap.budget) << " MiB budget (peak "
+           << toMiB(heap.peakUsage) << "), vma " << toMiB(heap.allocationBytes) << " MiB in "
+           << heap.allocationCount << " allocations, " << toMiB(heap.blockBytes) << " MiB in "
+           << heap.blockCount << " blocks\n";
+    }
+    for (const PoolSample& pool : _pools) {
+        os << "  pool " << memoryPoolName(pool.pool) << " : " << toMiB(pool.allocationBytes)
+           << " MiB in " << pool.allocationCount << " allocations, " << toMiB(pool.blockBytes)
+           << " MiB in " << pool.blockCount << " blocks\n";
+    }
+    os.flags(flags);
+    os.precision(precision);
+}
+
+void MemoryMonitor::writeJson(JsonWriter& writer) const {
+    writer.beginObject();
+    writer.key("budget_extension").value(_pDevice->memoryBudgetSupported());
+    writer.key("samples").value(_sampleCount);
+    writer.key("pressure_samples").value(_pressureCount);
+    writer.key("heaps").beginArray();
+    for (const HeapSample& heap : _heaps) {
+        writer.beginObject();
+        writer.key("size").value((uint64_t)heap.size);
+        writer.key("device_local").value(heap.deviceLocal);
+        writer.key("budget").value((uint64_t)heap.budget);
+        writer.key("usage").value((uint64_t)heap.usage);
+        writer.key("peak_usage").value((uint64_t)heap.peakUsage);
+        writer.key("blocks").value(heap.blockCount);
+        writer.key("block_bytes").value((uint64_t)heap.blockBytes);
+        writer.key("allocations").value(heap.allocationCount);
+        writer.key("allocation_bytes").value((uint64_t)heap.allocationBytes);
+        writer.endObject();
+    }
+    writer.endArray();
+    writer.key("pools").beginObject();
+    for (const PoolSample& pool : _pools) {
+        writer.key(memoryPoolName(pool.pool)).beginObject();
+        writer.key("blocks").value(pool.blockCount);
+        writer.key("block_bytes").value((uint64_t)pool.blockBytes);
+        writer.key("allocations").value(pool.allocationCount);
+        writer.key("allocation_bytes").value((uint64_t)pool.allocationBytes);
+        writer.endObject();
+    }
+    writer.endObject();
+    writer.endObject();
+}
+
+bool MemoryMonitor::writeAllocatorDump(const std::string& path) const {
+    char* statsString = nullptr;
+    vmaBuildStatsString(_pDevice->allocator(), &statsString, VK_TRUE);
+    std::ofstream ofs(path);
+    ofs << statsString << '\n';
+    vmaFreeStatsString(_pDevice->allocator(), statsString);
+    if (!ofs) {
+        std::cerr << "Error while writing allocator dump " << path << '\n';
+        return false;
+    }
+    std::cout << "Wrote allocator dump to " << path << '\n';
+    return true;
+}
+} // namespace render
\ No newline at end of file
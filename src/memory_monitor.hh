@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "device.hh"
+#include "json_writer.hh"
+
+namespace render {
+struct HeapSample {
+    vk::DeviceSize size = 0;
+    bool deviceLocal = false;
+    // what the process may use before the driver starts paging, from VK_EXT_memory_budget or
+    // estimated by VMA without it
+    vk::DeviceSize budget = 0;
+    vk::DeviceSize usage = 0; // whole process, as seen by the driver
+    vk::DeviceSize peakUsage = 0;
+    // VMA side of the usage
+    uint32_t blockCount = 0;
+    uint32_t allocationCount = 0;
+    vk::DeviceSize blockBytes = 0;
+    vk::DeviceSize allocationBytes = 0;
+};
+
+struct PoolSample {
+    render::MemoryPool pool;
+    uint32_t blockCount = 0;
+    uint32_t allocationCount = 0;
+    vk::DeviceSize blockBytes = 0;
+    vk::DeviceSize allocationBytes = 0;
+};
+
+// Periodic samples of the VMA heap budgets and statistics, warns once a heap nears its budget.
+class MemoryMonitor {
+private:
+    std::shared_ptr<const render::Device> _pDevice;
+    std::vector<HeapSample> _heaps;
+    std::vector<PoolSample> _pools; // the custom pools the device could create
+    uint64_t _sampleCount = 0;
+    uint64_t _pressureCount = 0; // samples where a heap was over the pressure ratio
+    bool _underPressure = false;
+
+public:
+    MemoryMonitor(std::shared_ptr<const render::Device> pDevice);
+
+    // Budgets are refreshed by VMA when the frame index changes
+    void sample(uint32_t frameIndex);
+
+    const std::vector<HeapSample>& heaps() const {
+        return _heaps;
+    }
+    const std::vector<PoolSample>& pools() const {
+        return _pools;
+    }
+    void printReport(std::ostream& os) const;
+    void writeJson(JsonWriter& writer) const;
+    // Detailed JSON of vmaBuildStatsString, every block and allocation of the allocator
+    bool writeAllocatorDump(const std::string& path) const;
+};
+} // namespace render
\ No newline at end of file
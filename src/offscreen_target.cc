@@ -0,0 +1,172 @@
+#include "offscreen_target.hh"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace render {
+OffscreenTarget::OffscreenTarget(std::shared_ptr<const render::Device> pDevice,
+                                 vk::Extent2D extent, uint32_t imageCount)
+    : _pDevice(pDevice), _extent(extent), _imageCount(imageCount) {
+    createImages();
+    createImageViews();
+}
+
+OffscreenTarget::~OffscreenTarget() {
+    _imageViews.clear();
+    for (size_t i = 0; i < _images.size(); i++) {
+        vmaDestroyImage(_pDevice->allocator(), _images[i], _allocations[i]);
+    }
+}
+
+void OffscreenTarget::createImages() {
+    VkImageCreateInfo imageCreateInfo{};
+    imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageCreateInfo.format = static_cast<VkFormat>(_format);
+    imageCreateInfo.extent = {_extent.width, _extent.height, 1};
+    imageCreateInfo.mipLevels = 1;
+    imageCreateInfo.arrayLayers = 1;
+    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VmaAllocationCreateInfo allocCreateInfo{};
+    allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+    for (uint32_t i = 0; i < _imageCount; i++) {
+        VkImage image;
+        VmaAllocation allocation;
+        auto result = vmaCreateImage(_pDevice->allocator(), &imageCreateInfo, &allocCreateInfo,
+                                     &image, &allocation, 0);
+        if (result != VkResult::VK_SUCCESS) {
+            std::cerr << "vmaCreateImage failed : " << result << "\n";
+            exit(-1);
+        }
+        _images.push_back(vk::Image(image));
+        _allocations.push_back(allocation);
+    }
+}
+
+void OffscreenTarget::createImageViews() {
+    try {
+        for (auto& image : _images) {
+            vk::ImageViewCreateInfo imageViewCreateInfo;
+            imageViewCreateInfo.image = image;
+            imageViewCreateInfo.format = _format;
+            imageViewCreateInfo.viewType = vk::ImageViewType::e2D;
+            imageViewCreateInfo.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+            imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+            imageViewCreateInfo.subresourceRange.levelCount = 1;
+            imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+            imageViewCreateInfo.subresourceRange.layerCount = 1;
+            _imageViews.push_back(_pDevice->device().createImageView(imageViewCreateInfo));
+        }
+    } catch (std::exception& e) {
+        std::cerr << "Error while creating offscreen image views : " << e.what() << '\n';
+        exit(-1);
+    }
+}
+
+uint32_t OffscreenTarget::acquire(const vk::raii::Semaphore& imageAvailable) {
+    // images are handed out round robin, the timeline wait of the frame slot already guarantees
+    // that the frame which last rendered into this image has completed as long as there are as
+    // many images as frames
+    uint32_t imageIndex = _nextImage;
+    _nextImage = (_nextImage + 1) % _imageCount;
+    return imageIndex;
+}
+
+void OffscreenTarget::present(const vk::raii::Semaphore& renderFinished, uint32_t imageIndex) {
+    // nothing to show, the image stays in transfer source layout for an eventual readback
+}
+
+void OffscreenTarget::writePpm(const std::string& path, uint32_t imageIndex) const {
+    VkDeviceSize size = (VkDeviceSize)_extent.width * _extent.height * 4;
+    VkBufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.size = size;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocCreateInfo{};
+    allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+    allocCreateInfo.flags =
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    // freed before the next readback, the transient pool allocates it from the start of its
+    // block, larger images fall back to the default heuristics
+    allocCreateInfo.pool = _pDevice->memoryPool(MemoryPool::TRANSIENT);
+
+    VkBuffer readbackBuffer;
+    VmaAllocation readbackAllocation;
+    VmaAllocationInfo readbackAllocationInfo;
+    auto result = vmaCreateBuffer(_pDevice->allocator(), &bufferCreateInfo, &allocCreateInfo,
+                                  &readbackBuffer, &readbackAllocation, &readbackAllocationInfo);
+    if (result != VkResult::VK_SUCCESS && allocCreateInfo.pool != VK_NULL_HANDLE) {
+        allocCreateInfo.pool = VK_NULL_HANDLE;
+        result = vmaCreateBuffer(_pDevice->allocator(), &bufferCreateInfo, &allocCreateInfo,
+                                 &readbackBuffer, &readbackAllocation, &readbackAllocationInfo);
+    }
+    if (result != VkResult::VK_SUCCESS) {
+        std::cerr << "vmaCreateBuffer failed : " << result << "\n";
+        exit(-1);
+    }
+
+    try {
+        vk::CommandBufferAllocateInfo commandBufferAllocInfo;
+        commandBufferAllocInfo.level = vk::CommandBufferLevel::ePrimary;
+        commandBufferAllocInfo.commandPool = *_pDevice->graphicsCommandPool();
+        commandBufferAllocInfo.commandBufferCount = 1;
+        vk::raii::CommandBuffer commandBuffer =
+            std::move(_pDevice->device().allocateCommandBuffers(commandBufferAllocInfo).at(0));
+
+        vk::CommandBufferBeginInfo beginInfo;
+        beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+        commandBuffer.begin(beginInfo);
+
+        // make the render pass writes visible to the copy, the layout does not change
+        vk::ImageMemoryBarrier barrier;
+        barrier.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+        barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+        barrier.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
+        barrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = _images.at(imageIndex);
+        barrier.subresourceRange = {vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1};
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                                      vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, barrier);
+
+        vk::BufferImageCopy copyRegion;
+        copyRegion.imageSubresource = {vk::ImageAspectFlagBits::eColor, 0, 0, 1};
+        copyRegion.imageExtent = vk::Extent3D{_extent.width, _extent.height, 1};
+        commandBuffer.copyImageToBuffer(_images.at(imageIndex),
+                                        vk::ImageLayout::eTransferSrcOptimal,
+                                        vk::Buffer(readbackBuffer), copyRegion);
+        commandBuffer.end();
+
+        render::Timeline& timeline = _pDevice->graphicsTimeline();
+        timeline.wait(timeline.submit({*commandBuffer}));
+    } catch (std::exception& e) {
+        std::cerr << "Error while reading back offscreen image : " << e.what() << '\n';
+        exit(-1);
+    }
+
+    vmaInvalidateAllocation(_pDevice->allocator(), readbackAllocation, 0, VK_WHOLE_SIZE);
+    const uint8_t* pixels = static_cast<const uint8_t*>(readbackAllocationInfo.pMappedData);
+    std::ofstream ofs(path, std::ios::binary);
+    ofs << "P6\n" << _extent.width << ' ' << _extent.height << "\n255\n";
+    for (VkDeviceSize i = 0; i < size; i += 4) {
+        ofs.write(reinterpret_cast<const char*>(pixels + i), 3);
+    }
+    if (!ofs) {
+        std::cerr << "Error while writing " << path << '\n';
+    } else {
+        std::cout << "Wrote " << path << '\n';
+    }
+    vmaDestroyBuffer(_pDevice->allocator(), readbackBuffer, readbackAllocation);
+}
+} // namespace render
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include <vector>
+#include <memory>
+#include <string>
+
+#include "device.hh"
+#include "render_target.hh"
+
+#include "vk_mem_alloc.h"
+
+namespace render {
+// Render target made of VMA allocated images, used when no window server is available.
+class OffscreenTarget : public RenderTarget {
+private:
+    std::shared_ptr<const render::Device> _pDevice;
+    vk::Format _format = vk::Format::eR8G8B8A8Srgb;
+    vk::Extent2D _extent;
+    uint32_t _imageCount;
+    uint32_t _nextImage = 0;
+    std::vector<vk::Image> _images;
+    std::vector<VmaAllocation> _allocations;
+    std::vector<vk::raii::ImageView> _imageViews;
+
+    void createImages();
+    void createImageViews();
+
+public:
+    OffscreenTarget(std::shared_ptr<const render::Device> pDevice, vk::Extent2D extent,
+                    uint32_t imageCount);
+    ~OffscreenTarget();
+    OffscreenTarget(const OffscreenTarget&) = delete;
+    OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+
+    vk::Format format() const override {
+        return _format;
+    }
+    vk::Extent2D extent() const override {
+        return _extent;
+    }
+    const std::vector<vk::raii::ImageView>& imageViews() const override {
+        return _imageViews;
+    }
+    vk::ImageLayout finalLayout() const override {
+        return vk::ImageLayout::eTransferSrcOptimal;
+    }
+    bool usesSemaphores() const override {
+        return false;
+    }
+    uint32_t acquire(const vk::raii::Semaphore& imageAvailable) override;
+    void present(const vk::raii::Semaphore& renderFinished, uint32_t imageIndex) override;
+
+    // Copies an image back to the host and writes it as a binary PPM, waits for the device
+    void writePpm(const std::string& path, uint32_t imageIndex) const;
+    uint32_t lastImage() const {
+        return (_nextImage + _imageCount - 1) % _imageCount;
+    }
+};
+} // namespace render
\ No newline at end of file
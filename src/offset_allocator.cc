@@ -0,0 +1,66 @@
+#include "offset_allocator.hh"
+
+#include <iostream>
+#include <iterator>
+
+namespace render {
+OffsetAllocator::OffsetAllocator(uint64_t capacity) : _capacity(capacity) {
+    if (capacity > 0) insertFree(0, capacity);
+}
+
+void OffsetAllocator::insertFree(uint64_t offset, uint64_t size) {
+    _freeByOffset.emplace(offset, size);
+    _freeBySize.emplace(size, offset);
+}
+
+void OffsetAllocator::eraseFree(std::map<uint64_t, uint64_t>::iterator it) {
+    _freeBySize.erase({it->second, it->first});
+    _freeByOffset.erase(it);
+}
+
+bool OffsetAllocator::allocate(uint64_t size, uint64_t& offset) {
+    if (size == 0) return false;
+    auto sizeIt = _freeBySize.lower_bound({size, 0});
+    if (sizeIt == _freeBySize.end()) return false;
+    uint64_t blockSize = sizeIt->first;
+    offset = sizeIt->second;
+    eraseFree(_freeByOffset.find(offset));
+    if (blockSize > size) insertFree(offset + size, blockSize - size);
+    _allocated.emplace(offset, size);
+    _used += size;
+    return true;
+}
+
+void OffsetAllocator::free(uint64_t offset) {
+    auto allocatedIt = _allocated.find(offset);
+    if (allocatedIt == _allocated.end()) {
+        std::cerr << "OffsetAllocator::free of an unknown offset " << offset << '\n';
+        exit(-1);
+    }
+    uint64_t size = allocatedIt->second;
+    _allocated.erase(allocatedIt);
+    _used -= size;
+
+    auto next = _freeByOffset.lower_bound(offset);
+    if (next != _freeByOffset.end() && next->first == offset + size) {
+        size += next->second;
+        eraseFree(next);
+        next = _freeByOffset.lower_bound(offset);
+    }
+    if (next != _freeByOffset.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            size += previous->second;
+            eraseFree(previous);
+        }
+    }
+    insertFree(offset, size);
+}
+
+double OffsetAllocator::fragmentation() const {
+    uint64_t freeSpace = _capacity - _used;
+    if (freeSpace == 0) return 0.0;
+    return 1.0 - (double)largestFreeBlock() / freeSpace;
+}
+} // namespace render
\ No newline at end of file
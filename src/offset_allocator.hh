@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <utility>
+
+namespace render {
+// Hands out ranges of a fixed size space, the buffer behind it is managed by the owner. Free
+// blocks are indexed by size for best fit and by offset so a freed block merges with its
+// neighbours, both in O(log n).
+class OffsetAllocator {
+private:
+    uint64_t _capacity;
+    uint64_t _used = 0;
+    // (size, offset), unique so a block is found and erased with a single lookup
+    std::set<std::pair<uint64_t, uint64_t>> _freeBySize;
+    std::map<uint64_t, uint64_t> _freeByOffset; // offset to size
+    std::map<uint64_t, uint64_t> _allocated;    // offset to size
+
+    void insertFree(uint64_t offset, uint64_t size);
+    void eraseFree(std::map<uint64_t, uint64_t>::iterator it);
+
+public:
+    OffsetAllocator(uint64_t capacity);
+
+    // Best fit, the lowest offset among equal sizes, false when no free block is large enough
+    bool allocate(uint64_t size, uint64_t& offset);
+    void free(uint64_t offset);
+
+    uint64_t capacity() const {
+        return _capacity;
+    }
+    uint64_t used() const {
+        return _used;
+    }
+    uint64_t largestFreeBlock() const {
+        return _freeBySize.empty() ? 0 : _freeBySize.rbegin()->first;
+    }
+    size_t freeBlockCount() const {
+        return _freeByOffset.size();
+    }
+    // Share of the free space outside the largest free block, 0 when it is all contiguous
+    double fragmentation() const;
+};
+} // namespace render
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include "options.hh"
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+namespace render {
+static void printUsage(const char* program) {
+    std::cout << "Usage : " << program << " [options]\n"
+              << "  --frames-in-flight N   number of frames recorded ahead of the GPU (1-8)\n"
+              << "  --record-threads N     threads recording the draws into secondary command\n"
+              << "                         buffers, 1 records inline (default 1)\n"
+              << "  --static               record the draws once per framebuffer and replay them,\n"
+              << "                         the uniforms no longer change, not with\n"
+              << "                         --record-threads\n"
+              << "  --jobs N               job system workers besides the main thread\n"
+              << "                         (default one per core minus one)\n"
+              << "  --pacing POLICY        uncapped, fixed or present (default fixed)\n"
+              << "  --target-fps HZ        frame rate of the fixed pacing policy (default 60)\n"
+              << "  --headless             render offscreen without a window or surface\n"
+              << "  --frames N             stop after N frames (default 100 when headless)\n"
+              << "  --size WxH             size of the window or offscreen images\n"
+              << "  --output FILE.ppm      headless only, write the last frame to a PPM file\n"
+              << "  --device SELECTOR      physical device index, UUID or name substring\n"
+              << "                         (default PAIN_BAGNAT_DEVICE, else the best score)\n"
+              << "  --sharing MODE         concurrent or exclusive buffers when transfers run\n"
+              << "                         on their own queue family (default concurrent)\n"
+              << "  --stats FILE.json      write frame statistics as JSON at exit\n"
+              << "  --trace FILE.json      record a Chrome trace (default PAIN_BAGNAT_TRACE),\n"
+              << "                         written at exit and when receiving SIGUSR1\n"
+              << "  --vma-dump FILE.json   write the detailed VMA statistics at exit and when\n"
+              << "                         receiving SIGUSR1\n"
+              << "  --help                 print this message\n";
+}
+
+const char* nextArgument(int argc, char** argv, int& i) {
+    if (i + 1 >= argc) {
+        throw std::runtime_error(std::string("missing value after ") + argv[i]);
+    }
+    return argv[++i];
+}
+
+void parseSize(const std::string& size, uint32_t& width, uint32_t& height) {
+    size_t separator = size.find('x');
+    if (separator == std::string::npos) {
+        throw std::runtime_error("--size expects WxH");
+    }
+    width = (uint32_t)std::stoul(size.substr(0, separator));
+    height = (uint32_t)std::stoul(size.substr(separator + 1));
+    if (width == 0 || height == 0) {
+        throw std::runtime_error("--size must not be empty");
+    }
+}
+
+uint32_t parseJobWorkers(const std::string& value) {
+    int workers = std::stoi(value);
+    if (workers < 0 || workers > 256) {
+        throw std::runtime_error("--jobs must be between 0 and 256");
+    }
+    return (uint32_t)workers;
+}
+
+void checkStaticCommands(bool staticCommands, uint32_t recordThreads) {
+    // the static recording is replayed whole, there is nothing left to record in parallel
+    if (staticCommands && recordThreads > 1) {
+        throw std::runtime_error("--static cannot be combined with --record-threads");
+    }
+}
+
+Options parseOptions(int argc, char** argv) {
+    Options options;
+    if (const char* tracePath = std::getenv("PAIN_BAGNAT_TRACE")) {
+        options.tracePath = tracePath;
+    }
+    bool pacingSet = false;
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--frames-in-flight") {
+                int value = std::stoi(nextArgument(argc, argv, i));
+                if (value < 1 || value > 8) {
+                    throw std::runtime_error("--frames-in-flight must be between 1 and 8");
+                }
+                options.framesInFlight = (uint32_t)value;
+            } else if (arg == "--record-threads") {
+                int value = std::stoi(nextArgument(argc, argv, i));
+                if (value < 1 || value > 64) {
+                    throw std::runtime_error("--record-threads must be between 1 and 64");
+                }
+                options.recordThreads = (uint32_t)value;
+            } else if (arg == "--static") {
+                options.staticCommands = true;
+            } else if (arg == "--jobs") {
+                options.jobWorkers = parseJobWorkers(nextArgument(argc, argv, i));
+            } else if (arg == "--pacing") {
+                options.pacingPolicy = parsePacingPolicy(nextArgument(argc, argv, i));
+                pacingSet = true;
+            } else if (arg == "--target-fps") {
+                options.targetFps = std::stod(nextArgument(argc, argv, i));
+                if (options.targetFps <= 0.0) {
+                    throw std::runtime_error("--target-fps must be positive");
+                }
+            } else if (arg == "--headless") {
+                options.headless = true;
+            } else if (arg == "--frames") {
+                options.frameCount = std::stoull(nextArgument(argc, argv, i));
+            } else if (arg == "--size") {
+                parseSize(nextArgument(argc, argv, i), options.width, options.height);
+            } else if (arg == "--output") {
+                options.outputPath = nextArgument(argc, argv, i);
+            } else if (arg == "--device") {
+                options.deviceSelector = nextArgument(argc, argv, i);
+            } else if (arg == "--sharing") {
+                options.sharingMode = parseSharingMode(nextArgument(argc, argv, i));
+            } else if (arg == "--stats") {
+                options.statsPath = nextArgument(argc, argv, i);
+            } else if (arg == "--trace") {
+                options.tracePath = nextArgument(argc, argv, i);
+            } else if (arg == "--vma-dump") {
+                options.allocatorDumpPath = nextArgument(argc, argv, i);
+            } else if (arg == "--help") {
+                printUsage(argv[0]);
+                exit(0);
+            } else {
+                throw std::runtime_error("unknown option " + arg);
+            }
+        }
+        checkStaticCommands(options.staticCommands, options.recordThreads);
+        if (options.headless) {
+            if (options.frameCount == 0) options.frameCount = 100;
+            // nothing is displayed, run as fast as possible unless asked otherwise
+            if (!pacingSet) options.pacingPolicy = PacingPolicy::UNCAPPED;
+            if (options.pacingPolicy == PacingPolicy::PRESENT_DRIVEN) {
+                throw std::runtime_error("present pacing needs a window");
+            }
+        } else if (!options.outputPath.empty()) {
+            throw std::runtime_error("--output is only supported with --headless");
+        }
+    } catch (std::exception& e) {
+        std::cerr << "Error while parsing options : " << e.what() << '\n';
+        printUsage(argv[0]);
+        exit(-1);
+    }
+    return options;
+}
+} // namespace render
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "device.hh"
+#include "frame_pacer.hh"
+
+namespace render {
+struct Options {
+    uint32_t framesInFlight = 2;
+    uint32_t recordThreads = 1; // 1 records the draws inline in the primary command buffer
+    bool staticCommands = false; // records the draws once per framebuffer and replays them
+    uint32_t jobWorkers = JobSystem::defaultWorkerCount();
+    PacingPolicy pacingPolicy = PacingPolicy::FIXED_RATE;
+    double targetFps = 60.0;
+    bool headless = false;
+    uint64_t frameCount = 0; // 0 runs until the window is closed
+    uint32_t width = 800;
+    uint32_t height = 450;
+    std::string outputPath; // headless only, PPM of the last frame
+    std::string deviceSelector; // overrides PAIN_BAGNAT_DEVICE when set
+    SharingMode sharingMode = SharingMode::CONCURRENT;
+    std::string statsPath;      // JSON stats written at exit
+    std::string tracePath;      // Chrome trace written at exit and on SIGUSR1
+    std::string allocatorDumpPath; // VMA JSON dump written at exit and on SIGUSR1
+};
+
+Options parseOptions(int argc, char** argv);
+
+// Shared with the benchmark command line, they throw std::runtime_error on invalid values.
+const char* nextArgument(int argc, char** argv, int& i);
+void parseSize(const std::string& size, uint32_t& width, uint32_t& height);
+uint32_t parseJobWorkers(const std::string& value);
+void checkStaticCommands(bool staticCommands, uint32_t recordThreads);
+} // namespace render
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include "parallel_recorder.hh"
+
+#include <algorithm>
+#include <iostream>
+
+#include "trace.hh"
+
+namespace render {
+ParallelRecorder::ParallelRecorder(std::shared_ptr<const render::Device> pDevice,
+                                   uint32_t framesInFlight, uint32_t maxSlices,
+                                   size_t minItemsPerSlice)
+    : _pDevice(pDevice),
+      _maxSlices(std::max(maxSlices, 1u)),
+      _minItemsPerSlice(std::max<size_t>(minItemsPerSlice, 1)) {
+    createSlices(framesInFlight);
+}
+
+void ParallelRecorder::createSlices(uint32_t framesInFlight) {
+    try {
+        vk::CommandPoolCreateInfo commandPoolInfo;
+        commandPoolInfo.flags = vk::CommandPoolCreateFlagBits::eTransient;
+        commandPoolInfo.queueFamilyIndex = _pDevice->graphicsQueueFamily().index;
+        _frames.resize(framesInFlight);
+        for (auto& slices : _frames) {
+            slices.resize(_maxSlices);
+            for (Slice& slice : slices) {
+                slice.commandPool = _pDevice->device().createCommandPool(commandPoolInfo);
+                vk::CommandBufferAllocateInfo commandBufferAllocInfo;
+                commandBufferAllocInfo.commandPool = *slice.commandPool;
+                commandBufferAllocInfo.level = vk::CommandBufferLevel::eSecondary;
+                commandBufferAllocInfo.commandBufferCount = 1;
+                slice.commandBuffer = std::move(
+                    _pDevice->device().allocateCommandBuffers(commandBufferAllocInfo).at(0));
+            }
+        }
+    } catch (std::exception& e) {
+        std::cerr << "Error while creating recording command pools : " << e.what() << '\n';
+        exit(-1);
+    }
+}
+
+void ParallelRecorder::recordSlice(Slice& slice,
+                                   const vk::CommandBufferInheritanceInfo& inheritance,
+                                   size_t begin, size_t end, const RecordFunction& record) {
+    TRACE_SCOPE("ParallelRecorder::slice");
+    slice.commandPool.reset();
+    vk::CommandBufferBeginInfo beginInfo;
+    beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit |
+                      vk::CommandBufferUsageFlagBits::eRenderPassContinue;
+    beginInfo.pInheritanceInfo = &inheritance;
+    slice.commandBuffer.begin(beginInfo);
+    record(slice.commandBuffer, begin, end);
+    slice.commandBuffer.end();
+}
+
+std::vector<vk::CommandBuffer> ParallelRecorder::record(
+    uint32_t frameIndex, const vk::CommandBufferInheritanceInfo& inheritance, size_t itemCount,
+    const RecordFunction& record) {
+    if (itemCount == 0) return {};
+    render::JobSystem& jobSystem = _pDevice->jobSystem();
+    size_t sliceCount = (itemCount + _minItemsPerSlice - 1) / _minItemsPerSlice;
+    sliceCount = std::min<size_t>({sliceCount, _maxSlices, jobSystem.threadCount()});
+    std::vector<Slice>& slices = _frames[frameIndex];
+    render::JobCounter counter;
+    for (size_t i = 1; i < sliceCount; i++) {
+        size_t begin = itemCount * i / sliceCount;
+        size_t end = itemCount * (i + 1) / sliceCount;
+        jobSystem.run(
+            [&, i, begin, end]() { recordSlice(slices[i], inheritance, begin, end, record); },
+            counter);
+    }
+    recordSlice(slices[0], inheritance, 0, itemCount / sliceCount, record);
+    jobSystem.wait(counter);
+
+    std::vector<vk::CommandBuffer> commandBuffers;
+    for (size_t i = 0; i < sliceCount; i++) commandBuffers.push_back(*slices[i].commandBuffer);
+    return commandBuffers;
+}
+} // namespace render
\ No newline at end of file
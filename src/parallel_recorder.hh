@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "device.hh"
+
+namespace render {
+// Records slices of a draw list into secondary command buffers as jobs of the device job system.
+// Each slice has a command pool per frame in flight and a single job records it, so the pools
+// need no locking. The buffers come back in slice order, ready to be executed by the primary.
+class ParallelRecorder {
+public:
+    // Records the items [begin, end) into a secondary command buffer already begun inside the
+    // render pass, it runs concurrently with the other slices
+    using RecordFunction = std::function<void(const vk::raii::CommandBuffer& commandBuffer,
+                                              size_t begin, size_t end)>;
+
+private:
+    struct Slice {
+        vk::raii::CommandPool commandPool = 0;
+        vk::raii::CommandBuffer commandBuffer = 0;
+    };
+
+    std::shared_ptr<const render::Device> _pDevice;
+    uint32_t _maxSlices;
+    size_t _minItemsPerSlice;
+    std::vector<std::vector<Slice>> _frames; // the slices of every frame in flight
+
+    void createSlices(uint32_t framesInFlight);
+    void recordSlice(Slice& slice, const vk::CommandBufferInheritanceInfo& inheritance,
+                     size_t begin, size_t end, const RecordFunction& record);
+
+public:
+    // Slices smaller than minItemsPerSlice are merged since a secondary buffer has to rebind the
+    // whole state
+    ParallelRecorder(std::shared_ptr<const render::Device> pDevice, uint32_t framesInFlight,
+                     uint32_t maxSlices, size_t minItemsPerSlice = 256);
+    ParallelRecorder(const ParallelRecorder&) = delete;
+    ParallelRecorder& operator=(const ParallelRecorder&) = delete;
+
+    // Splits the items in contiguous slices recorded in parallel, the calling thread records the
+    // first one and helps with the others. The previous use of the frame slot must have
+    // completed.
+    std::vector<vk::CommandBuffer> record(uint32_t frameIndex,
+                                          const vk::CommandBufferInheritanceInfo& inheritance,
+                                          size_t itemCount, const RecordFunction& record);
+
+    uint32_t maxSlices() const {
+        return _maxSlices;
+    }
+};
+} // namespace render
\ No newline at end of file
@@ -1,24 +1,50 @@
 #include "pipeline.hh"
 
 #include <iostream>
+#include <stdexcept>
 
 #include "build_defs.hh"
 
 namespace render {
-void Pipeline::createVertShaderModule() {
-    _vertShaderModule = createShaderModule(std::string(PROJECT_SOURCE_DIR) + "/shaders/basic.vert",
-                                           SHADER_TYPE::VERT);
+VertexFormat parseVertexFormat(const std::string& name) {
+    if (name == "basic") return VertexFormat::BASIC;
+    if (name == "compact") return VertexFormat::COMPACT;
+    throw std::runtime_error("unknown vertex format " + name);
 }
 
-void Pipeline::createFragShaderModule() {
-    _fragShaderModule = createShaderModule(std::string(PROJECT_SOURCE_DIR) + "/shaders/basic.frag",
-                                           SHADER_TYPE::FRAG);
+const char* vertexFormatName(VertexFormat format) {
+    switch (format) {
+        case VertexFormat::BASIC:
+            return "basic";
+        case VertexFormat::COMPACT:
+            return "compact";
+    }
+    return "unknown";
 }
 
-vk::raii::ShaderModule Pipeline::createShaderModule(const std::string& path, SHADER_TYPE type) {
-    try {
-        auto spv = ShaderCompiler::compileAssembly(path, type);
+size_t vertexSize(VertexFormat format) {
+    return format == VertexFormat::COMPACT ? sizeof(VertexCompact) : sizeof(VertexBasic);
+}
 
+void Pipeline::createShaderModules() {
+    std::string name = _vertexFormat == VertexFormat::COMPACT ? "compact.vert" : "basic.vert";
+    std::string vertPath = std::string(PROJECT_SOURCE_DIR) + "/shaders/" + name;
+    std::string fragPath = std::string(PROJECT_SOURCE_DIR) + "/shaders/basic.frag";
+    // compiling dominates the pipeline creation, the stages compile in parallel
+    std::vector<uint32_t> vertSpv, fragSpv;
+    render::JobSystem& jobSystem = _pDevice->jobSystem();
+    render::JobCounter counter;
+    jobSystem.run([&]() { vertSpv = ShaderCompiler::compileAssembly(vertPath, SHADER_TYPE::VERT); },
+                  counter);
+    fragSpv = ShaderCompiler::compileAssembly(fragPath, SHADER_TYPE::FRAG);
+    jobSystem.wait(counter);
+    _vertShaderModule = createShaderModule(vertPath, vertSpv);
+    _fragShaderModule = createShaderModule(fragPath, fragSpv);
+}
+
+vk::raii::ShaderModule Pipeline::createShaderModule(const std::string& path,
+                                                    const std::vector<uint32_t>& spv) {
+    try {
         vk::ShaderModuleCreateInfo shaderModuleCreateInfo;
         shaderModuleCreateInfo.setCode(spv);
         return _pDevice->device().createShaderModule(shaderModuleCreateInfo);
@@ -33,7 +59,8 @@ void Pipeline::createDescriptorSetLayout() {
     try {
         vk::DescriptorSetLayoutBinding uboLayoutBinding;
         uboLayoutBinding.binding = 0;
-        uboLayoutBinding.descriptorType = vk::DescriptorType::eUniformBuffer;
+        // per draw data lives in a uniform ring and is selected with a dynamic offset
+        uboLayoutBinding.descriptorType = vk::DescriptorType::eUniformBufferDynamic;
         uboLayoutBinding.descriptorCount = 1;
         uboLayoutBinding.stageFlags = vk::ShaderStageFlagBits::eFragment;
 
@@ -50,7 +77,7 @@ void Pipeline::createDescriptorSetLayout() {
 void Pipeline::createPipelineLayout() {
     try {
         vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
-        // pipelineLayoutInfo.setSetLayouts(*_descriptorSetLayout);
+        pipelineLayoutInfo.setSetLayouts(*_descriptorSetLayout);
         _layout = _pDevice->device().createPipelineLayout(pipelineLayoutInfo);
     } catch (std::exception& e) {
         std::cerr << "Error while creating pipeline layout : " << e.what() << '\n';
@@ -60,14 +87,14 @@ void Pipeline::createPipelineLayout() {
 
 void Pipeline::createRenderPass() {
     vk::AttachmentDescription colorAttachment;
-    colorAttachment.format = _pSwapChain->surfaceFormat().format;
+    colorAttachment.format = _pTarget->format();
     colorAttachment.samples = vk::SampleCountFlagBits::e1;
     colorAttachment.loadOp = vk::AttachmentLoadOp::eClear;
     colorAttachment.storeOp = vk::AttachmentStoreOp::eStore;
     colorAttachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
     colorAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
     colorAttachment.initialLayout = vk::ImageLayout::eUndefined;
-    colorAttachment.finalLayout = vk::ImageLayout::ePresentSrcKHR;
+    colorAttachment.finalLayout = _pTarget->finalLayout();
 
     vk::AttachmentReference colorAttachmentRef;
     colorAttachmentRef.attachment = 0;
@@ -108,12 +135,19 @@ void Pipeline::createGraphicsPipeline() {
     std::vector<vk::PipelineShaderStageCreateInfo> stages{vertShaderStageInfo, fragShaderStageInfo};
 
     vk::PipelineVertexInputStateCreateInfo vertexInputInfo;
-    vk::VertexInputBindingDescription vertexBasicBindingDescription =
-        VertexBasic::bindingDescription();
-    vertexInputInfo.setVertexBindingDescriptions(vertexBasicBindingDescription);
-    std::array<vk::VertexInputAttributeDescription, 3> vertexBasicAttributeDescriptions =
-        VertexBasic::attributeDescriptions();
-    vertexInputInfo.setVertexAttributeDescriptions(vertexBasicAttributeDescriptions);
+    vk::VertexInputBindingDescription vertexBindingDescription;
+    std::vector<vk::VertexInputAttributeDescription> vertexAttributeDescriptions;
+    if (_vertexFormat == VertexFormat::COMPACT) {
+        vertexBindingDescription = VertexCompact::bindingDescription();
+        auto attributes = VertexCompact::attributeDescriptions();
+        vertexAttributeDescriptions.assign(attributes.begin(), attributes.end());
+    } else {
+        vertexBindingDescription = VertexBasic::bindingDescription();
+        auto attributes = VertexBasic::attributeDescriptions();
+        vertexAttributeDescriptions.assign(attributes.begin(), attributes.end());
+    }
+    vertexInputInfo.setVertexBindingDescriptions(vertexBindingDescription);
+    vertexInputInfo.setVertexAttributeDescriptions(vertexAttributeDescriptions);
 
     vk::PipelineInputAssemblyStateCreateInfo inputAssemblyInfo;
     inputAssemblyInfo.primitiveRestartEnable = false;
@@ -173,15 +207,15 @@ void Pipeline::createGraphicsPipeline() {
 }
 
 void Pipeline::createFramebuffers() {
-    _framebuffers.reserve(_pSwapChain->imageViews().size());
-    for (size_t i = 0; i < _pSwapChain->imageViews().size(); i++) {
+    _framebuffers.reserve(_pTarget->imageViews().size());
+    for (size_t i = 0; i < _pTarget->imageViews().size(); i++) {
         try {
-            vk::ImageView attachments[] = {*(_pSwapChain->imageViews()).at(i)};
+            vk::ImageView attachments[] = {*(_pTarget->imageViews()).at(i)};
             vk::FramebufferCreateInfo framebufferInfo{};
             framebufferInfo.renderPass = *_renderPass;
             framebufferInfo.setAttachments(attachments);
-            framebufferInfo.width = _pSwapChain->extent().width;
-            framebufferInfo.height = _pSwapChain->extent().height;
+            framebufferInfo.width = _pTarget->extent().width;
+            framebufferInfo.height = _pTarget->extent().height;
             framebufferInfo.layers = 1;
             _framebuffers.push_back(_pDevice->device().createFramebuffer(framebufferInfo));
         } catch (std::exception& e) {
@@ -192,11 +226,11 @@ void Pipeline::createFramebuffers() {
 }
 
 Pipeline::Pipeline(std::shared_ptr<const render::Device> pDevice,
-                   std::shared_ptr<const render::SwapChain> pSwapChain)
-    : _pDevice(pDevice), _pSwapChain(pSwapChain) {
-    createVertShaderModule();
-    createFragShaderModule();
-    // createDescriptorSetLayout();
+                   std::shared_ptr<const render::RenderTarget> pTarget,
+                   VertexFormat vertexFormat)
+    : _pDevice(pDevice), _pTarget(pTarget), _vertexFormat(vertexFormat) {
+    createShaderModules();
+    createDescriptorSetLayout();
     createPipelineLayout();
     createRenderPass();
     createGraphicsPipeline();
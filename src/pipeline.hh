@@ -4,9 +4,11 @@
 #include <glm/glm.hpp>
 #include <vulkan/vulkan.hpp>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "device.hh"
-#include "swap_chain.hh"
+#include "render_target.hh"
 #include "shader_compiler.hh"
 
 struct VertexBasic {
@@ -42,15 +44,47 @@ struct VertexBasic {
     }
 };
 
+// Position only, for scenes that measure vertex fetch bandwidth
+struct VertexCompact {
+    glm::vec3 position;
+
+    static vk::VertexInputBindingDescription bindingDescription() {
+        vk::VertexInputBindingDescription bindingDescription;
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(VertexCompact);
+        bindingDescription.inputRate = vk::VertexInputRate::eVertex;
+        return bindingDescription;
+    }
+
+    static std::array<vk::VertexInputAttributeDescription, 1> attributeDescriptions() {
+        std::array<vk::VertexInputAttributeDescription, 1> attributeDescriptions;
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = vk::Format::eR32G32B32Sfloat;
+        attributeDescriptions[0].offset = offsetof(VertexCompact, position);
+        return attributeDescriptions;
+    }
+};
+
 struct UniformBufferObject0 {
     glm::vec3 color;
 };
 
 namespace render {
+enum class VertexFormat {
+    BASIC,  // VertexBasic
+    COMPACT // VertexCompact
+};
+
+VertexFormat parseVertexFormat(const std::string& name);
+const char* vertexFormatName(VertexFormat format);
+size_t vertexSize(VertexFormat format);
+
 class Pipeline {
 private:
     std::shared_ptr<const render::Device> _pDevice;
-    std::shared_ptr<const render::SwapChain> _pSwapChain;
+    std::shared_ptr<const render::RenderTarget> _pTarget;
+    VertexFormat _vertexFormat;
     vk::raii::ShaderModule _vertShaderModule = 0;
     vk::raii::ShaderModule _fragShaderModule = 0;
     vk::raii::DescriptorSetLayout _descriptorSetLayout = 0;
@@ -59,9 +93,9 @@ private:
     vk::raii::Pipeline _pipeline = 0;
     std::vector<vk::raii::Framebuffer> _framebuffers;
 
-    void createVertShaderModule();
-    void createFragShaderModule();
-    vk::raii::ShaderModule createShaderModule(const std::string& path, SHADER_TYPE type);
+    void createShaderModules();
+    vk::raii::ShaderModule createShaderModule(const std::string& path,
+                                              const std::vector<uint32_t>& spv);
     void createDescriptorSetLayout();
     void createPipelineLayout();
     void createRenderPass();
@@ -70,13 +104,20 @@ private:
 
 public:
     Pipeline(std::shared_ptr<const render::Device> pDevice,
-             std::shared_ptr<const render::SwapChain> pSwapChain);
+             std::shared_ptr<const render::RenderTarget> pTarget,
+             VertexFormat vertexFormat = VertexFormat::BASIC);
     const vk::raii::RenderPass& renderPass() const {
         return _renderPass;
     }
     const vk::raii::Pipeline& pipeline() const {
         return _pipeline;
     }
+    const vk::raii::PipelineLayout& layout() const {
+        return _layout;
+    }
+    const vk::raii::DescriptorSetLayout& descriptorSetLayout() const {
+        return _descriptorSetLayout;
+    }
     const std::vector<vk::raii::Framebuffer>& framebuffers() const {
         return _framebuffers;
     }
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include <vector>
+
+namespace render {
+// Set of images the pipeline renders into, either a swapchain or offscreen images.
+class RenderTarget {
+public:
+    virtual ~RenderTarget() = default;
+
+    virtual vk::Format format() const = 0;
+    virtual vk::Extent2D extent() const = 0;
+    virtual const std::vector<vk::raii::ImageView>& imageViews() const = 0;
+    // Layout the render pass leaves the images in
+    virtual vk::ImageLayout finalLayout() const = 0;
+    // True when acquire signals and present waits on the semaphores they are given, the frame
+    // submission must then wait on and signal them
+    virtual bool usesSemaphores() const = 0;
+
+    // Returns the index of the next image to render into
+    virtual uint32_t acquire(const vk::raii::Semaphore& imageAvailable) = 0;
+    virtual void present(const vk::raii::Semaphore& renderFinished, uint32_t imageIndex) = 0;
+};
+} // namespace render
\ No newline at end of file
@@ -0,0 +1,83 @@
+#include "render_thread.hh"
+
+#include <algorithm>
+#include <iomanip>
+#include <utility>
+
+#include "trace.hh"
+
+namespace render {
+void HandoffStats::print(std::ostream& os) const {
+    std::ios_base::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << "HANDOFF : " << published << " snapshots published, " << taken << " rendered over "
+       << frames << " frames, age when picked up " << std::fixed << std::setprecision(3)
+       << meanAge * 1000.0 << " ms mean, " << maxAge * 1000.0 << " ms max\n";
+    os.flags(flags);
+    os.precision(precision);
+}
+
+void HandoffStats::writeJson(JsonWriter& writer) const {
+    writer.beginObject();
+    writer.key("published").value(published);
+    writer.key("taken").value(taken);
+    writer.key("frames").value(frames);
+    writer.key("mean_age_ms").value(meanAge * 1000.0);
+    writer.key("max_age_ms").value(maxAge * 1000.0);
+    writer.endObject();
+}
+
+RenderThread::RenderThread(render::Renderer& renderer, uint64_t frameLimit,
+                           FrameCallback afterFrame, ExitCallback onExit)
+    : _renderer(renderer),
+      _frameLimit(frameLimit),
+      _afterFrame(std::move(afterFrame)),
+      _onExit(std::move(onExit)) {
+    _thread = std::thread(&RenderThread::run, this);
+}
+
+RenderThread::~RenderThread() {
+    stop();
+}
+
+void RenderThread::publish() {
+    _snapshots.back().sequence = ++_published;
+    _snapshots.back().publishTime = Tracer::now();
+    _snapshots.publish();
+}
+
+void RenderThread::run() {
+    if (Tracer::enabled()) Tracer::setThreadName("render");
+    render::FrameTimer& frameTimer = _renderer.frameTimer();
+    double totalAge = 0.0;
+    while (!_stopRequested.load(std::memory_order_acquire)) {
+        if (_frameLimit != 0 && _stats.frames >= _frameLimit) break;
+        if (_snapshots.take()) {
+            double age = (Tracer::now() - _snapshots.front().publishTime) * 1e-9;
+            totalAge += age;
+            _stats.maxAge = std::max(_stats.maxAge, age);
+            _stats.taken++;
+        }
+        frameTimer.beginFrame();
+        _renderer.renderFrame(_snapshots.front());
+        frameTimer.endFrame();
+        _stats.frames++;
+        if (_afterFrame) _afterFrame();
+    }
+    _renderer.waitIdle();
+    if (_stats.taken) _stats.meanAge = totalAge / _stats.taken;
+    _finished.store(true, std::memory_order_release);
+    if (_onExit) _onExit();
+}
+
+void RenderThread::stop() {
+    _stopRequested.store(true, std::memory_order_release);
+    if (_thread.joinable()) _thread.join();
+}
+
+HandoffStats RenderThread::stats() const {
+    HandoffStats stats = _stats;
+    stats.published = _published;
+    return stats;
+}
+} // namespace render
\ No newline at end of file
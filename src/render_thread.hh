@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <thread>
+
+#include "renderer.hh"
+#include "triple_buffer.hh"
+#include "json_writer.hh"
+
+namespace render {
+struct HandoffStats {
+    uint64_t published = 0; // snapshots published by the application
+    uint64_t taken = 0;     // snapshots picked up by the render thread, the others were skipped
+    uint64_t frames = 0;    // frames rendered
+    double meanAge = 0.0;   // seconds between publishing a snapshot and picking it up
+    double maxAge = 0.0;
+
+    void print(std::ostream& os) const;
+    void writeJson(JsonWriter& writer) const;
+};
+
+// Renders frames on a thread of its own, the only one submitting and presenting once started.
+// The application thread keeps the window and its events, it publishes snapshots of its state
+// through a triple buffer and never waits on the renderer. Every frame renders the latest
+// snapshot, possibly the same as the previous frame.
+class RenderThread {
+public:
+    // Called on the render thread after every frame, for reports and dumps
+    using FrameCallback = std::function<void()>;
+    // Called on the render thread once it stopped on its own, to wake the application
+    using ExitCallback = std::function<void()>;
+
+private:
+    render::Renderer& _renderer;
+    uint64_t _frameLimit; // 0 renders until stopped
+    FrameCallback _afterFrame;
+    ExitCallback _onExit;
+    render::TripleBuffer<render::FrameSnapshot> _snapshots;
+    std::atomic<bool> _stopRequested{false};
+    std::atomic<bool> _finished{false};
+    uint64_t _published = 0; // application thread only
+    HandoffStats _stats;     // render thread only until joined
+    std::thread _thread;
+
+    void run();
+
+public:
+    RenderThread(render::Renderer& renderer, uint64_t frameLimit, FrameCallback afterFrame,
+                 ExitCallback onExit);
+    ~RenderThread();
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+
+    // Application thread, the snapshot to fill then publish
+    render::FrameSnapshot& snapshot() {
+        return _snapshots.back();
+    }
+    void publish();
+
+    // True once the frame limit was reached
+    bool finished() const {
+        return _finished.load(std::memory_order_acquire);
+    }
+    // Finishes the frame in flight, waits for the device and joins the thread
+    void stop();
+    // Only meaningful once stopped
+    HandoffStats stats() const;
+};
+} // namespace render
\ No newline at end of file
@@ -0,0 +1,263 @@
+#include "renderer.hh"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace render {
+// frames between two memory samples, computing the VMA statistics walks every block
+constexpr uint64_t MEMORY_SAMPLE_INTERVAL = 60;
+
+Renderer::Renderer(std::shared_ptr<const render::Device> pDevice,
+                   std::shared_ptr<render::RenderTarget> pTarget,
+                   std::shared_ptr<const render::Scene> pScene,
+                   std::shared_ptr<render::FramePacer> pPacer, uint32_t framesInFlight,
+                   uint32_t recordThreads, bool staticCommands, size_t timerCapacity)
+    : _pDevice(pDevice),
+      _pTarget(pTarget),
+      _pScene(pScene),
+      _pPacer(pPacer),
+      _pPipeline(std::make_unique<render::Pipeline>(pDevice, pTarget,
+                                                    pScene->parameters().vertexFormat)),
+      _pUniformRing(std::make_unique<render::UniformRing>(
+          pDevice, _pPipeline->descriptorSetLayout(), framesInFlight,
+          (uint32_t)pScene->draws().size(), sizeof(UniformBufferObject0))),
+      _frameRing(pDevice, framesInFlight),
+      _frameTimer(timerCapacity),
+      _gpuProfiler(pDevice, framesInFlight),
+      _memoryMonitor(pDevice),
+      _defragmenter(pDevice),
+      _pendingUpload(pScene->uploadToken()) {
+    // the options reject static commands with several recording threads
+    if (staticCommands) {
+        uint32_t framebufferCount = (uint32_t)_pPipeline->framebuffers().size();
+        _pStaticCommands = std::make_unique<render::StaticCommands>(pDevice, framebufferCount);
+        // every framebuffer has its own recording and so its own uniforms
+        _pStaticUniformRing = std::make_unique<render::UniformRing>(
+            pDevice, _pPipeline->descriptorSetLayout(), 1,
+            (uint32_t)pScene->draws().size() * framebufferCount, sizeof(UniformBufferObject0));
+    } else if (recordThreads > 1) {
+        _pRecorder = std::make_unique<render::ParallelRecorder>(pDevice, framesInFlight,
+                                                                recordThreads);
+    }
+    createRenderFinishedSemaphores();
+}
+
+void Renderer::createRenderFinishedSemaphores() {
+    try {
+        vk::SemaphoreCreateInfo semaphoreInfo;
+        for (size_t i = 0; i < _pTarget->imageViews().size(); i++) {
+            _renderFinishedSemaphores.push_back(
+                _pDevice->device().createSemaphore(semaphoreInfo));
+        }
+    } catch (std::exception& e) {
+        std::cerr << "Error while creating sync elements : " << e.what() << '\n';
+        exit(-1);
+    }
+}
+
+void Renderer::recordDraws(const vk::raii::CommandBuffer& commandBuffer, size_t begin,
+                           size_t end, float pulse, render::UniformRing& uniformRing) {
+    // secondary command buffers inherit no state, every slice binds everything again
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, *_pPipeline->pipeline());
+
+    vk::Viewport viewport;
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(_pTarget->extent().width);
+    viewport.height = static_cast<float>(_pTarget->extent().height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    commandBuffer.setViewport(0, viewport);
+
+    vk::Rect2D scissor;
+    scissor.offset = vk::Offset2D{0, 0};
+    scissor.extent = _pTarget->extent();
+    commandBuffer.setScissor(0, scissor);
+
+    _pScene->bind(commandBuffer);
+    const std::vector<render::DrawCommand>& draws = _pScene->draws();
+    for (size_t i = begin; i < end; i++) {
+        const render::DrawCommand& draw = draws[i];
+        render::UniformAllocation uniforms = uniformRing.allocate(sizeof(UniformBufferObject0));
+        UniformBufferObject0 ubo;
+        ubo.color = draw.color * pulse;
+        std::memcpy(uniforms.data, &ubo, sizeof(ubo));
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, *_pPipeline->layout(),
+                                         0, *uniformRing.descriptorSet(), uniforms.offset);
+        commandBuffer.drawIndexed(draw.indexCount, 1, draw.firstIndex, draw.vertexOffset, 0);
+    }
+}
+
+void Renderer::recordCommands(const vk::raii::CommandBuffer& commandBuffer, uint32_t imageIndex,
+                              const render::FrameSnapshot& snapshot) {
+    vk::CommandBufferBeginInfo beginInfo;
+    beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+    commandBuffer.begin(beginInfo);
+    _gpuProfiler.beginFrame(commandBuffer, _frameRing.currentIndex());
+    _frameTimer.setGpuTime(_gpuProfiler.lastFrameTime());
+    // writes queued before the frame go out with it, with exclusive buffers on a dedicated
+    // transfer family the frame acquires the ranges those batches released
+    render::UploadBatcher& uploadBatcher = _pDevice->uploadBatcher();
+    uploadBatcher.flush();
+    std::vector<vk::BufferMemoryBarrier> acquires =
+        uploadBatcher.takeAcquireBarriers(_acquireUpload);
+    if (!acquires.empty()) {
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eVertexInput,
+                                      vk::PipelineStageFlagBits::eVertexInput, {}, {}, acquires,
+                                      {});
+    }
+    {
+        render::GpuProfiler::Scope gpuScope(_gpuProfiler, commandBuffer, "render_pass");
+        vk::RenderPassBeginInfo renderPassInfo;
+        renderPassInfo.renderPass = *_pPipeline->renderPass();
+        renderPassInfo.framebuffer = *_pPipeline->framebuffers()[imageIndex];
+        renderPassInfo.renderArea.offset = vk::Offset2D{0, 0};
+        renderPassInfo.renderArea.extent = _pTarget->extent();
+        vk::ClearValue clearValue = vk::ClearValue{{0.0f, 0.0f, 0.0f, 1.0f}};
+        renderPassInfo.setClearValues(clearValue);
+        vk::CommandBufferInheritanceInfo inheritance;
+        inheritance.renderPass = *_pPipeline->renderPass();
+        inheritance.subpass = 0;
+        inheritance.framebuffer = *_pPipeline->framebuffers()[imageIndex];
+        recordRenderPass(commandBuffer, renderPassInfo, inheritance, imageIndex, snapshot.pulse);
+    }
+    commandBuffer.end();
+}
+
+void Renderer::recordRenderPass(const vk::raii::CommandBuffer& commandBuffer,
+                                const vk::RenderPassBeginInfo& renderPassInfo,
+                                const vk::CommandBufferInheritanceInfo& inheritance,
+                                uint32_t imageIndex, float pulse) {
+    size_t drawCount = _pScene->draws().size();
+    if (_pStaticCommands) {
+        // the recordings keep the uniforms they were recorded with, moved geometry buffers
+        // change the generation of the scene
+        if (_pStaticCommands->update(_pScene->generation())) _pStaticUniformRing->beginFrame(0);
+        vk::CommandBuffer secondary = _pStaticCommands->get(
+            imageIndex, inheritance, [&](const vk::raii::CommandBuffer& staticCommands) {
+                recordDraws(staticCommands, 0, drawCount, 1.0f, *_pStaticUniformRing);
+                _pStaticUniformRing->flush();
+            });
+        commandBuffer.beginRenderPass(renderPassInfo,
+                                      vk::SubpassContents::eSecondaryCommandBuffers);
+        commandBuffer.executeCommands(secondary);
+        commandBuffer.endRenderPass();
+        return;
+    }
+    // uniforms are rewritten every frame
+    _pUniformRing->beginFrame(_frameRing.currentIndex());
+    if (_pRecorder) {
+        commandBuffer.beginRenderPass(renderPassInfo,
+                                      vk::SubpassContents::eSecondaryCommandBuffers);
+        std::vector<vk::CommandBuffer> secondaries = _pRecorder->record(
+            _frameRing.currentIndex(), inheritance, drawCount,
+            [&](const vk::raii::CommandBuffer& secondary, size_t begin, size_t end) {
+                recordDraws(secondary, begin, end, pulse, *_pUniformRing);
+            });
+        if (!secondaries.empty()) commandBuffer.executeCommands(secondaries);
+    } else {
+        commandBuffer.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
+        recordDraws(commandBuffer, 0, drawCount, pulse, *_pUniformRing);
+    }
+    _pUniformRing->flush();
+    commandBuffer.endRenderPass();
+}
+
+void Renderer::renderFrame() {
+    // without an application driving it the animation advances with the frames, a slow pulse
+    // keeps the uniforms changing
+    render::FrameSnapshot snapshot;
+    snapshot.sequence = _frameRing.frameNumber();
+    snapshot.pulse = 0.75f + 0.25f * std::sin(_frameRing.frameNumber() * 0.05f);
+    renderFrame(snapshot);
+}
+
+void Renderer::renderFrame(const render::FrameSnapshot& snapshot) {
+    if (_frameRing.frameNumber() % MEMORY_SAMPLE_INTERVAL == 0) {
+        _memoryMonitor.sample((uint32_t)_frameRing.frameNumber());
+    }
+    {
+        auto scope = _frameTimer.scope(render::FramePhase::PACING);
+        _pPacer->waitForNextFrame();
+    }
+    render::FrameContext& frame = _frameRing.current();
+    {
+        auto scope = _frameTimer.scope(render::FramePhase::TIMELINE_WAIT);
+        frame.waitAndReset();
+    }
+    // moved buffers are read from their new place by the frames recorded from now on
+    _pendingUpload.merge(_defragmenter.step(_frameRing.frameNumber()));
+    uint32_t imageIndex;
+    {
+        auto scope = _frameTimer.scope(render::FramePhase::ACQUIRE);
+        imageIndex = _pTarget->acquire(frame.imageAvailableSemaphore());
+    }
+    const vk::raii::CommandBuffer& commandBuffer = frame.commandBuffer();
+    {
+        auto scope = _frameTimer.scope(render::FramePhase::RECORD);
+        recordCommands(commandBuffer, imageIndex, snapshot);
+    }
+    {
+        auto scope = _frameTimer.scope(render::FramePhase::SUBMIT);
+        std::vector<render::SemaphoreWait> waits;
+        std::vector<vk::Semaphore> signals;
+        if (_pTarget->usesSemaphores()) {
+            waits.push_back(render::SemaphoreWait{
+                *frame.imageAvailableSemaphore(), 0,
+                vk::PipelineStageFlagBits::eColorAttachmentOutput});
+            signals.push_back(*_renderFinishedSemaphores.at(imageIndex));
+        }
+        // once the host has seen the upload complete later frames no longer need to wait, an
+        // acquire is always ordered after its release
+        render::UploadBatcher& uploadBatcher = _pDevice->uploadBatcher();
+        if (uploadBatcher.completed(_pendingUpload)) _pendingUpload = render::UploadToken();
+        render::UploadToken uploadWait = _pendingUpload;
+        uploadWait.merge(_acquireUpload);
+        if (uploadWait.value != 0) {
+            waits.push_back(render::SemaphoreWait{*uploadBatcher.timeline(), uploadWait.value,
+                                                  vk::PipelineStageFlagBits::eVertexInput});
+        }
+        frame.setSubmitValue(_pDevice->graphicsTimeline().submit({*commandBuffer}, waits, signals));
+    }
+    {
+        auto scope = _frameTimer.scope(render::FramePhase::PRESENT);
+        _pTarget->present(_renderFinishedSemaphores.at(imageIndex), imageIndex);
+    }
+    _frameRing.advance();
+}
+
+void Renderer::waitIdle() const {
+    _pDevice->waitSubmitted();
+}
+
+void Renderer::writeJson(JsonWriter& writer) const {
+    writer.beginObject();
+    writer.key("frames_in_flight").value(_frameRing.size());
+    writer.key("record_threads").value(recordThreads());
+    if (_pStaticCommands) {
+        writer.key("static_commands");
+        _pStaticCommands->stats().writeJson(writer);
+    }
+    writer.key("pacing").value(render::pacingPolicyName(_pPacer->policy()));
+    writer.key("scene").value(_pScene->parameters().name());
+    writer.key("frame_timer");
+    _frameTimer.writeJson(writer);
+    writer.key("gpu_profiler");
+    _gpuProfiler.writeJson(writer);
+    writer.key("memory");
+    _memoryMonitor.writeJson(writer);
+    writer.key("defragmentation");
+    _defragmenter.writeJson(writer);
+    writer.key("geometry_pool");
+    _pScene->geometryPool().writeJson(writer);
+    writer.key("uploads");
+    _pDevice->uploadBatcher().stats().writeJson(writer);
+    writer.key("deletions");
+    _pDevice->deletionQueue().stats().writeJson(writer);
+    writer.key("jobs");
+    _pDevice->jobSystem().stats().writeJson(writer);
+    writer.endObject();
+}
+} // namespace render
\ No newline at end of file
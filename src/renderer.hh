@@ -0,0 +1,125 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include <memory>
+
+#include "device.hh"
+#include "render_target.hh"
+#include "pipeline.hh"
+#include "scene.hh"
+#include "uniform_ring.hh"
+#include "frame_context.hh"
+#include "frame_pacer.hh"
+#include "frame_timer.hh"
+#include "gpu_profiler.hh"
+#include "memory_monitor.hh"
+#include "defragmenter.hh"
+#include "parallel_recorder.hh"
+#include "static_commands.hh"
+#include "json_writer.hh"
+
+namespace render {
+// Application state a frame is rendered from, published by the thread running the application
+// and never modified once published
+struct FrameSnapshot {
+    uint64_t sequence = 0;
+    uint64_t publishTime = 0; // Tracer::now() when published
+    double time = 0.0;        // application time, seconds
+    float pulse = 1.0f;       // scales the colors of the draws
+    double cursorX = 0.0;     // window coordinates
+    double cursorY = 0.0;
+};
+
+// Drives the frames of a scene into a render target, shared by the viewer and the benchmark.
+class Renderer {
+private:
+    std::shared_ptr<const render::Device> _pDevice;
+    std::shared_ptr<render::RenderTarget> _pTarget;
+    std::shared_ptr<const render::Scene> _pScene;
+    std::shared_ptr<render::FramePacer> _pPacer;
+    std::unique_ptr<render::Pipeline> _pPipeline;
+    std::unique_ptr<render::UniformRing> _pUniformRing;
+    render::FrameRing _frameRing;
+    render::FrameTimer _frameTimer;
+    render::GpuProfiler _gpuProfiler;
+    render::MemoryMonitor _memoryMonitor;
+    render::Defragmenter _defragmenter; // ends its run before the scene buffers can go away
+    std::unique_ptr<render::ParallelRecorder> _pRecorder; // null when recording inline
+    // replayed instead of recording the draws, null unless the scene is static
+    std::unique_ptr<render::StaticCommands> _pStaticCommands;
+    std::unique_ptr<render::UniformRing> _pStaticUniformRing;
+    render::UploadToken _pendingUpload; // waited on by the next submissions until it completes
+    render::UploadToken _acquireUpload; // releases acquired by the frame being recorded
+    // signaled by the frame rendering into an image and waited on by its presentation, nothing
+    // tells when the presentation engine consumed it so it belongs to the image, not to the
+    // frame slot which may come round before the image is presented
+    std::vector<vk::raii::Semaphore> _renderFinishedSemaphores;
+
+    void createRenderFinishedSemaphores();
+
+    void recordCommands(const vk::raii::CommandBuffer& commandBuffer, uint32_t imageIndex,
+                        const render::FrameSnapshot& snapshot);
+    // Records the draws inline, in parallel slices or replays their static recording
+    void recordRenderPass(const vk::raii::CommandBuffer& commandBuffer,
+                          const vk::RenderPassBeginInfo& renderPassInfo,
+                          const vk::CommandBufferInheritanceInfo& inheritance,
+                          uint32_t imageIndex, float pulse);
+    // Records the draws [begin, end) with the whole state they need, called from the recording
+    // threads
+    void recordDraws(const vk::raii::CommandBuffer& commandBuffer, size_t begin, size_t end,
+                     float pulse, render::UniformRing& uniformRing);
+
+public:
+    Renderer(std::shared_ptr<const render::Device> pDevice,
+             std::shared_ptr<render::RenderTarget> pTarget,
+             std::shared_ptr<const render::Scene> pScene,
+             std::shared_ptr<render::FramePacer> pPacer, uint32_t framesInFlight,
+             uint32_t recordThreads = 1, bool staticCommands = false,
+             size_t timerCapacity = 4096);
+    Renderer(const Renderer&) = delete;
+    Renderer& operator=(const Renderer&) = delete;
+
+    // Paces, records, submits and presents one frame, must be called between
+    // FrameTimer::beginFrame and FrameTimer::endFrame
+    void renderFrame();
+    // Renders the state of an application instead of animating on its own
+    void renderFrame(const render::FrameSnapshot& snapshot);
+    // Waits for every submission made so far, other threads may keep uploading meanwhile
+    void waitIdle() const;
+    // Makes the next frames wait on the GPU for an upload they read
+    void waitForUpload(const render::UploadToken& token) {
+        _pendingUpload.merge(token);
+    }
+
+    render::FrameTimer& frameTimer() {
+        return _frameTimer;
+    }
+    render::GpuProfiler& gpuProfiler() {
+        return _gpuProfiler;
+    }
+    const render::MemoryMonitor& memoryMonitor() const {
+        return _memoryMonitor;
+    }
+    render::Defragmenter& defragmenter() {
+        return _defragmenter;
+    }
+    // Null unless the draws are recorded once and replayed
+    const render::StaticCommands* staticCommands() const {
+        return _pStaticCommands.get();
+    }
+    uint32_t recordThreads() const {
+        return _pRecorder ? _pRecorder->maxSlices() : 1;
+    }
+    const render::FrameRing& frameRing() const {
+        return _frameRing;
+    }
+    const render::Scene& scene() const {
+        return *_pScene;
+    }
+    const render::FramePacer& pacer() const {
+        return *_pPacer;
+    }
+
+    void writeJson(JsonWriter& writer) const;
+};
+} // namespace render
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include "scene.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace render {
+// bytes of vertices generated before uploading them
+constexpr size_t GEOMETRY_CHUNK_SIZE = 8 * 1024 * 1024;
+// fewest meshes generated by a job
+constexpr size_t GEOMETRY_GRAIN = 16;
+
+std::string SceneParameters::name() const {
+    return "d" + std::to_string(drawCount) + "_t" + std::to_string(trianglesPerDraw) + "_" +
+           vertexFormatName(vertexFormat);
+}
+
+// columns and rows of the smallest grid holding count cells
+static void gridSize(uint32_t count, uint32_t& columns, uint32_t& rows) {
+    columns = std::max(1u, (uint32_t)std::ceil(std::sqrt((double)count)));
+    rows = std::max(1u, (count + columns - 1) / columns);
+}
+
+// draw of a mesh, colored from its index
+static DrawCommand drawCommand(uint32_t draw, const render::MeshHandle& mesh) {
+    DrawCommand command;
+    command.indexCount = mesh.indexCount;
+    command.firstIndex = mesh.firstIndex;
+    command.vertexOffset = (int32_t)mesh.baseVertex;
+    // spread the hues so neighbouring draws are told apart
+    float hue = std::fmod(draw * 0.618034f, 1.0f) * 6.0f;
+    command.color = glm::clamp(glm::vec3(std::abs(hue - 3.0f) - 1.0f,
+                                         2.0f - std::abs(hue - 2.0f),
+                                         2.0f - std::abs(hue - 4.0f)),
+                               0.0f, 1.0f);
+    return command;
+}
+
+Scene::Scene(std::shared_ptr<const render::Device> pDevice, const SceneParameters& parameters)
+    : _pDevice(pDevice), _parameters(parameters) {
+    createGeometry();
+}
+
+void Scene::createGeometry() {
+    const uint32_t drawCount = std::max(1u, _parameters.drawCount);
+    const uint32_t triangles = std::max(1u, _parameters.trianglesPerDraw);
+    const uint32_t quads = (triangles + 1) / 2;
+    uint32_t quadColumns, quadRows;
+    gridSize(quads, quadColumns, quadRows);
+    uint32_t drawColumns, drawRows;
+    gridSize(drawCount, drawColumns, drawRows);
+
+    const uint32_t verticesPerDraw = (quadColumns + 1) * (quadRows + 1);
+    const size_t stride = vertexSize(_parameters.vertexFormat);
+
+    // same winding as the original quad : top right, top left, bottom left, bottom right, the
+    // indices are relative to the mesh so every draw shares them
+    std::vector<uint32_t> indices;
+    indices.reserve((size_t)triangles * 3);
+    for (uint32_t triangle = 0; triangle < triangles; triangle++) {
+        uint32_t quad = triangle / 2;
+        uint32_t x = quad % quadColumns;
+        uint32_t y = quad / quadColumns;
+        uint32_t topLeft = y * (quadColumns + 1) + x;
+        uint32_t topRight = topLeft + 1;
+        uint32_t bottomLeft = topLeft + quadColumns + 1;
+        uint32_t bottomRight = bottomLeft + 1;
+        if (triangle % 2 == 0) {
+            indices.insert(indices.end(), {topRight, topLeft, bottomLeft});
+        } else {
+            indices.insert(indices.end(), {topRight, bottomLeft, bottomRight});
+        }
+    }
+
+    _pGeometryPool = std::make_unique<render::GeometryPool>(
+        _pDevice, stride, drawCount * verticesPerDraw, drawCount * (uint32_t)indices.size());
+    const size_t drawBytes = (size_t)verticesPerDraw * stride;
+
+    // the draws share [-0.8, 0.8] with a small gap between cells
+    const float span = 1.6f;
+    const float cellWidth = span / drawColumns;
+    const float cellHeight = span / drawRows;
+    const float margin = drawCount > 1 ? 0.1f : 0.0f;
+    auto generate = [&](uint32_t draw, uint8_t* vertices) {
+        float left = -0.8f + (draw % drawColumns + margin) * cellWidth;
+        float top = -0.8f + (draw / drawColumns + margin) * cellHeight;
+        float width = cellWidth * (1.0f - 2 * margin);
+        float height = cellHeight * (1.0f - 2 * margin);
+
+        for (uint32_t y = 0; y <= quadRows; y++) {
+            for (uint32_t x = 0; x <= quadColumns; x++) {
+                glm::vec3 position{left + width * x / quadColumns, top + height * y / quadRows,
+                                   0.0f};
+                uint8_t* vertex = vertices + (y * (quadColumns + 1) + x) * stride;
+                if (_parameters.vertexFormat == VertexFormat::COMPACT) {
+                    VertexCompact compact{position};
+                    std::memcpy(vertex, &compact, sizeof(compact));
+                } else {
+                    VertexBasic basic{position, {0.0f, 0.0f, 1.0f},
+                                      {(float)x / quadColumns, (float)y / quadRows}};
+                    std::memcpy(vertex, &basic, sizeof(basic));
+                }
+            }
+        }
+    };
+
+    // the meshes of a chunk are generated by jobs then written in order and uploaded together,
+    // their allocations follow each other so a chunk is a single copy. A chunk bounds the memory
+    // held on the CPU.
+    render::JobSystem& jobSystem = _pDevice->jobSystem();
+    const uint32_t chunkDraws =
+        (uint32_t)std::max<size_t>(1, GEOMETRY_CHUNK_SIZE / std::max<size_t>(drawBytes, 1));
+    std::vector<uint8_t> vertices(std::min(chunkDraws, drawCount) * drawBytes);
+    for (uint32_t chunk = 0; chunk < drawCount; chunk += chunkDraws) {
+        uint32_t chunkEnd = std::min(drawCount, chunk + chunkDraws);
+        render::JobCounter counter;
+        jobSystem.parallelFor(
+            chunkEnd - chunk, GEOMETRY_GRAIN,
+            [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    generate(chunk + (uint32_t)i, vertices.data() + i * drawBytes);
+                }
+            },
+            counter);
+        jobSystem.wait(counter);
+
+        for (uint32_t draw = chunk; draw < chunkEnd; draw++) {
+            // the pool is sized for the scene, it cannot run out
+            render::MeshHandle mesh =
+                _pGeometryPool->allocate(verticesPerDraw, (uint32_t)indices.size());
+            _pGeometryPool->write(mesh, vertices.data() + (draw - chunk) * drawBytes,
+                                  indices.data());
+            _draws.push_back(drawCommand(draw, mesh));
+        }
+        _uploadToken.merge(_pGeometryPool->flush());
+    }
+    _triangleCount = (uint64_t)drawCount * triangles;
+}
+
+void Scene::bind(const vk::raii::CommandBuffer& commandBuffer) const {
+    _pGeometryPool->bind(commandBuffer);
+}
+} // namespace render
\ No newline at end of file
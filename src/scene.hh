@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "device.hh"
+#include "geometry_pool.hh"
+#include "pipeline.hh"
+
+namespace render {
+struct SceneParameters {
+    uint32_t drawCount = 1;
+    uint32_t trianglesPerDraw = 2;
+    VertexFormat vertexFormat = VertexFormat::BASIC;
+
+    // Short identifier such as d100_t2_basic, used to match benchmark runs with a baseline
+    std::string name() const;
+};
+
+struct DrawCommand {
+    uint32_t indexCount;
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+    glm::vec3 color;
+};
+
+// Synthetic geometry, every draw is a grid of triangles laid out in its own cell of the screen.
+// Every draw is a mesh of the same geometry pool.
+class Scene {
+private:
+    std::shared_ptr<const render::Device> _pDevice;
+    SceneParameters _parameters;
+    std::unique_ptr<render::GeometryPool> _pGeometryPool;
+    std::vector<DrawCommand> _draws;
+    uint64_t _triangleCount = 0;
+    render::UploadToken _uploadToken;
+
+    void createGeometry();
+
+public:
+    Scene(std::shared_ptr<const render::Device> pDevice, const SceneParameters& parameters);
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+
+    // Binds the geometry pool buffers every draw reads from
+    void bind(const vk::raii::CommandBuffer& commandBuffer) const;
+    // Changes when command buffers recorded with bind are no longer valid
+    uint64_t generation() const {
+        return _pGeometryPool->generation();
+    }
+
+    const SceneParameters& parameters() const {
+        return _parameters;
+    }
+    const std::vector<DrawCommand>& draws() const {
+        return _draws;
+    }
+    uint64_t triangleCount() const {
+        return _triangleCount;
+    }
+    const render::GeometryPool& geometryPool() const {
+        return *_pGeometryPool;
+    }
+    // The geometry is uploaded asynchronously, the first submission drawing it waits on this
+    const render::UploadToken& uploadToken() const {
+        return _uploadToken;
+    }
+};
+} // namespace render
\ No newline at end of file
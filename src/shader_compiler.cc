@@ -1,11 +1,14 @@
 #include "shader_compiler.hh"
 
+#include "trace.hh"
+
 static std::map<SHADER_TYPE, shaderc_shader_kind> shaderTypeMapping = {
     {VERT, shaderc_shader_kind::shaderc_vertex_shader},
     {FRAG, shaderc_shader_kind::shaderc_fragment_shader}};
 
 std::vector<uint32_t> ShaderCompiler::compileAssembly(const std::filesystem::path& filePath,
                                                       SHADER_TYPE type) {
+    TRACE_SCOPE("ShaderCompiler::compileAssembly");
     if (!std::filesystem::is_regular_file(filePath)) {
         std::cerr << filePath << " is not a valid file path\n";
         return std::vector<uint32_t>();
@@ -16,7 +19,7 @@ std::vector<uint32_t> ShaderCompiler::compileAssembly(const std::filesystem::pat
     shaderc::CompileOptions options;
 
     shaderc::SpvCompilationResult module = compiler.CompileGlslToSpv(
-        content.c_str(), shaderTypeMapping[type], filePath.c_str(), options);
+        content.c_str(), shaderTypeMapping.at(type), filePath.c_str(), options);
 
     if (module.GetCompilationStatus() != shaderc_compilation_status_success) {
         std::cerr << module.GetErrorMessage();
@@ -0,0 +1,85 @@
+#include "staging_ring.hh"
+
+#include <iostream>
+
+namespace render {
+constexpr vk::DeviceSize STAGING_ALIGNMENT = 16;
+
+StagingRing::StagingRing(VmaAllocator allocator, vk::DeviceSize capacity)
+    : _allocator(allocator), _capacity(capacity) {
+    createBuffer();
+}
+
+StagingRing::~StagingRing() {
+    vmaDestroyBuffer(_allocator, _buffer, _allocation);
+}
+
+void StagingRing::createBuffer() {
+    VkBuffer buffer;
+    VkBufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.size = _capacity;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocCreateInfo{};
+    allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+    allocCreateInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                            VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VmaAllocationInfo allocationInfo;
+    auto result = vmaCreateBuffer(_allocator, &bufferCreateInfo, &allocCreateInfo, &buffer,
+                                  &_allocation, &allocationInfo);
+    if (result != VkResult::VK_SUCCESS) {
+        std::cerr << "vmaCreateBuffer failed : " << result << "\n";
+        exit(-1);
+    }
+    _buffer = vk::Buffer(buffer);
+    _mapped = static_cast<uint8_t*>(allocationInfo.pMappedData);
+}
+
+bool StagingRing::tryReserve(vk::DeviceSize size, vk::DeviceSize& offset) {
+    bool empty = _segments.empty() && _openBytes == 0;
+    if (empty) {
+        _head = 0;
+        _tail = 0;
+    }
+    vk::DeviceSize aligned = (_head + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+    if (empty || _head > _tail) {
+        // free space is [head, capacity[ then [0, tail[
+        if (aligned + size <= _capacity) {
+            offset = aligned;
+        } else if (size < _tail) {
+            offset = 0;
+        } else {
+            return false;
+        }
+    } else if (aligned + size < _tail) {
+        // the head has wrapped, free space is [head, tail[, the head never catches up the tail
+        // so that head == tail always means empty
+        offset = aligned;
+    } else {
+        return false;
+    }
+    _openBytes += size;
+    _head = offset + size;
+    return true;
+}
+
+void StagingRing::close(uint64_t serial) {
+    if (_openBytes == 0) return;
+    _segments.push_back(Segment{serial, _head});
+    _openBytes = 0;
+}
+
+void StagingRing::release(uint64_t completedValue) {
+    while (!_segments.empty() && _segments.front().serial <= completedValue) {
+        _tail = _segments.front().end;
+        _segments.pop_front();
+    }
+}
+
+void StagingRing::flush(vk::DeviceSize offset, vk::DeviceSize size) const {
+    vmaFlushAllocation(_allocator, _allocation, offset, size);
+}
+} // namespace render
\ No newline at end of file
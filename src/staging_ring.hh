@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include <cstdint>
+#include <deque>
+
+#include "vk_mem_alloc.h"
+
+namespace render {
+// Persistently mapped host buffer that staging data is written into before being copied to
+// device local memory. Space is taken at the head and given back in order once the copies
+// reading it have completed, so staging memory never exceeds the capacity however much data
+// goes through it. Not synchronized, the upload batcher owning it is.
+class StagingRing {
+private:
+    struct Segment {
+        uint64_t serial; // completion value of the copies reading the segment
+        vk::DeviceSize end; // ring offset just past the segment
+    };
+
+    VmaAllocator _allocator;
+    vk::DeviceSize _capacity;
+    vk::Buffer _buffer;
+    VmaAllocation _allocation;
+    uint8_t* _mapped = nullptr;
+
+    vk::DeviceSize _head = 0; // next free byte
+    vk::DeviceSize _tail = 0; // oldest byte still in use
+    vk::DeviceSize _openBytes = 0; // reserved since the last close
+    std::deque<Segment> _segments;
+
+    void createBuffer();
+
+public:
+    StagingRing(VmaAllocator allocator, vk::DeviceSize capacity);
+    ~StagingRing();
+    StagingRing(const StagingRing&) = delete;
+    StagingRing& operator=(const StagingRing&) = delete;
+
+    // Takes size bytes at the head, false when they do not fit until older segments are released
+    bool tryReserve(vk::DeviceSize size, vk::DeviceSize& offset);
+    // Everything reserved since the previous close is read by copies completing at serial
+    void close(uint64_t serial);
+    // Gives back the segments whose copies completed up to the value
+    void release(uint64_t completedValue);
+    // Makes the host writes to a reserved range visible to the device
+    void flush(vk::DeviceSize offset, vk::DeviceSize size) const;
+
+    bool hasOpenBytes() const {
+        return _openBytes != 0;
+    }
+    // Completion value of the oldest segment still in use, 0 when none is
+    uint64_t oldestSerial() const {
+        return _segments.empty() ? 0 : _segments.front().serial;
+    }
+    uint8_t* mapped() const {
+        return _mapped;
+    }
+    const vk::Buffer& buffer() const {
+        return _buffer;
+    }
+    vk::DeviceSize capacity() const {
+        return _capacity;
+    }
+};
+} // namespace render
\ No newline at end of file
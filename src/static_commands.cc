@@ -0,0 +1,79 @@
+#include "static_commands.hh"
+
+#include <iostream>
+
+#include "trace.hh"
+
+namespace render {
+void StaticCommandStats::print(std::ostream& os) const {
+    os << "STATIC COMMANDS : " << recordings << " recordings, " << invalidations
+       << " invalidations, " << replays << " replays\n";
+}
+
+void StaticCommandStats::writeJson(JsonWriter& writer) const {
+    writer.beginObject();
+    writer.key("recordings").value(recordings);
+    writer.key("invalidations").value(invalidations);
+    writer.key("replays").value(replays);
+    writer.endObject();
+}
+
+StaticCommands::StaticCommands(std::shared_ptr<const render::Device> pDevice,
+                               uint32_t framebufferCount)
+    : _pDevice(pDevice) {
+    createCommandBuffers(framebufferCount);
+}
+
+void StaticCommands::createCommandBuffers(uint32_t framebufferCount) {
+    try {
+        vk::CommandPoolCreateInfo commandPoolInfo;
+        commandPoolInfo.queueFamilyIndex = _pDevice->graphicsQueueFamily().index;
+        _commandPool = _pDevice->device().createCommandPool(commandPoolInfo);
+
+        vk::CommandBufferAllocateInfo commandBufferAllocInfo;
+        commandBufferAllocInfo.commandPool = *_commandPool;
+        commandBufferAllocInfo.level = vk::CommandBufferLevel::eSecondary;
+        commandBufferAllocInfo.commandBufferCount = framebufferCount;
+        _commandBuffers = _pDevice->device().allocateCommandBuffers(commandBufferAllocInfo);
+        _recorded.assign(framebufferCount, false);
+    } catch (std::exception& e) {
+        std::cerr << "Error while creating static command buffers : " << e.what() << '\n';
+        exit(-1);
+    }
+}
+
+bool StaticCommands::update(uint64_t version) {
+    if (_valid && version == _version) return false;
+    TRACE_SCOPE("StaticCommands::invalidate");
+    // pending frames may still execute the recordings
+    render::Timeline& timeline = _pDevice->graphicsTimeline();
+    timeline.wait(timeline.submitted());
+    _commandPool.reset();
+    _recorded.assign(_recorded.size(), false);
+    _version = version;
+    _valid = true;
+    _stats.invalidations++;
+    return true;
+}
+
+vk::CommandBuffer StaticCommands::get(uint32_t framebufferIndex,
+                                      const vk::CommandBufferInheritanceInfo& inheritance,
+                                      const RecordFunction& record) {
+    const vk::raii::CommandBuffer& commandBuffer = _commandBuffers.at(framebufferIndex);
+    if (_recorded[framebufferIndex]) {
+        _stats.replays++;
+        return *commandBuffer;
+    }
+    TRACE_SCOPE("StaticCommands::record");
+    vk::CommandBufferBeginInfo beginInfo;
+    beginInfo.flags = vk::CommandBufferUsageFlagBits::eRenderPassContinue |
+                      vk::CommandBufferUsageFlagBits::eSimultaneousUse;
+    beginInfo.pInheritanceInfo = &inheritance;
+    commandBuffer.begin(beginInfo);
+    record(commandBuffer);
+    commandBuffer.end();
+    _recorded[framebufferIndex] = true;
+    _stats.recordings++;
+    return *commandBuffer;
+}
+} // namespace render
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "device.hh"
+#include "json_writer.hh"
+
+namespace render {
+struct StaticCommandStats {
+    uint64_t recordings = 0;    // secondary command buffers recorded
+    uint64_t invalidations = 0; // version changes, each waits for the graphics queue
+    uint64_t replays = 0;       // frames which reused a recording
+
+    void print(std::ostream& os) const;
+    void writeJson(JsonWriter& writer) const;
+};
+
+// Secondary command buffers recorded once per framebuffer and replayed by every frame drawing
+// to it. The caller passes a version of everything the recordings reference, when it changes
+// the graphics queue is waited on and every framebuffer is recorded again on its next use.
+class StaticCommands {
+public:
+    // Records into a secondary command buffer already begun inside the render pass
+    using RecordFunction = std::function<void(const vk::raii::CommandBuffer& commandBuffer)>;
+
+private:
+    std::shared_ptr<const render::Device> _pDevice;
+    vk::raii::CommandPool _commandPool = 0;
+    std::vector<vk::raii::CommandBuffer> _commandBuffers;
+    std::vector<bool> _recorded;
+    uint64_t _version = 0;
+    bool _valid = false;
+    StaticCommandStats _stats;
+
+    void createCommandBuffers(uint32_t framebufferCount);
+
+public:
+    StaticCommands(std::shared_ptr<const render::Device> pDevice, uint32_t framebufferCount);
+    StaticCommands(const StaticCommands&) = delete;
+    StaticCommands& operator=(const StaticCommands&) = delete;
+
+    // True when the recordings of an older version have to go, the caller then rewrites what
+    // they read before calling get, the GPU no longer uses it
+    bool update(uint64_t version);
+    // The recording of the framebuffer, recorded first when it is missing
+    vk::CommandBuffer get(uint32_t framebufferIndex,
+                          const vk::CommandBufferInheritanceInfo& inheritance,
+                          const RecordFunction& record);
+    // Drops every recording, for changes the version does not cover
+    void invalidate() {
+        _valid = false;
+    }
+
+    const StaticCommandStats& stats() const {
+        return _stats;
+    }
+};
+} // namespace render
\ No newline at end of file
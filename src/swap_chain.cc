@@ -1,11 +1,14 @@
 #include "swap_chain.hh"
 
+#include <algorithm>
 #include <iostream>
+#include <mutex>
 
 namespace render {
 
 SwapChain::SwapChain(std::shared_ptr<const render::Display> pDisplay,
-                     std::shared_ptr<const render::Device> pDevice)
+                     std::shared_ptr<const render::Device> pDevice,
+                     vk::PresentModeKHR preferredPresentMode)
     : _pDisplay(pDisplay), _pDevice(pDevice) {
     _extent.width = std::clamp(_pDisplay->width(),
                                _pDevice->swapChainSupport().capabilities.minImageExtent.width,
@@ -14,10 +17,23 @@ SwapChain::SwapChain(std::shared_ptr<const render::Display> pDisplay,
                                 _pDevice->swapChainSupport().capabilities.minImageExtent.height,
                                 _pDevice->swapChainSupport().capabilities.maxImageExtent.height);
     _imageCount = _pDevice->swapChainSupport().capabilities.minImageCount + 1;
+    selectPresentMode(preferredPresentMode);
     createSwapChain();
     createImageViews();
 }
 
+void SwapChain::selectPresentMode(vk::PresentModeKHR preferredPresentMode) {
+    const auto& presentModes = _pDevice->swapChainSupport().presentModes;
+    if (std::find(presentModes.begin(), presentModes.end(), preferredPresentMode) !=
+        presentModes.end()) {
+        _presentMode = preferredPresentMode;
+    } else {
+        // FIFO is the only mode the specification guarantees
+        _presentMode = vk::PresentModeKHR::eFifo;
+    }
+    std::cout << "Present mode " << vk::to_string(_presentMode) << " selected\n";
+}
+
 void SwapChain::createSwapChain() {
     try {
         vk::SwapchainCreateInfoKHR swapChainCreateInfo;
@@ -68,4 +84,21 @@ void SwapChain::createImageViews() {
         exit(-1);
     }
 }
+
+uint32_t SwapChain::acquire(const vk::raii::Semaphore& imageAvailable) {
+    return _swapChain.acquireNextImage(UINT64_MAX, *imageAvailable, nullptr).second;
+}
+
+void SwapChain::present(const vk::raii::Semaphore& renderFinished, uint32_t imageIndex) {
+    vk::PresentInfoKHR presentInfo;
+    presentInfo.setWaitSemaphores(*renderFinished);
+    presentInfo.setSwapchains(*_swapChain);
+    presentInfo.setImageIndices(imageIndex);
+    std::unique_lock<std::mutex> lock(_pDevice->graphicsTimeline().queueMutex());
+    auto result = _pDevice->graphicsQueue().presentKHR(presentInfo);
+    lock.unlock();
+    if (result != vk::Result::eSuccess) {
+        std::cerr << "presentKHR returned " << vk::to_string(result) << '\n';
+    }
+}
 } // namespace render
\ No newline at end of file
@@ -6,33 +6,47 @@
 
 #include "device.hh"
 #include "display.hh"
+#include "render_target.hh"
 
 namespace render {
-class SwapChain {
+class SwapChain : public RenderTarget {
 private:
     std::shared_ptr<const render::Display> _pDisplay;
     std::shared_ptr<const render::Device> _pDevice;
     uint32_t _imageCount;
     vk::SurfaceFormatKHR _surfaceFormat = {vk::Format::eB8G8R8A8Srgb,
                                            vk::ColorSpaceKHR::eSrgbNonlinear};
-    vk::PresentModeKHR _presentMode = vk::PresentModeKHR::eMailbox;
+    vk::PresentModeKHR _presentMode = vk::PresentModeKHR::eFifo;
     vk::Extent2D _extent;
     vk::raii::SwapchainKHR _swapChain = 0;
     std::vector<vk::raii::ImageView> _imageViews;
 
+    void selectPresentMode(vk::PresentModeKHR preferredPresentMode);
     void createSwapChain();
     void createImageViews();
 
 public:
     SwapChain(std::shared_ptr<const render::Display> pDisplay,
-              std::shared_ptr<const render::Device> pDevice);
+              std::shared_ptr<const render::Device> pDevice,
+              vk::PresentModeKHR preferredPresentMode = vk::PresentModeKHR::eMailbox);
     vk::SurfaceFormatKHR surfaceFormat() const {
         return _surfaceFormat;
     }
+    vk::Format format() const override {
+        return _surfaceFormat.format;
+    }
+    vk::ImageLayout finalLayout() const override {
+        return vk::ImageLayout::ePresentSrcKHR;
+    }
+    bool usesSemaphores() const override {
+        return true;
+    }
+    uint32_t acquire(const vk::raii::Semaphore& imageAvailable) override;
+    void present(const vk::raii::Semaphore& renderFinished, uint32_t imageIndex) override;
     vk::PresentModeKHR presentMode() const {
         return _presentMode;
     }
-    vk::Extent2D extent() const {
+    vk::Extent2D extent() const override {
         return _extent;
     }
     const vk::raii::SwapchainKHR& swapChain() const {
@@ -41,7 +55,7 @@ public:
     uint32_t imageCount() const {
         return _imageCount;
     }
-    const std::vector<vk::raii::ImageView>& imageViews() const {
+    const std::vector<vk::raii::ImageView>& imageViews() const override {
         return _imageViews;
     }
 };
@@ -0,0 +1,74 @@
+#include "timeline.hh"
+
+#include <iostream>
+#include <limits>
+
+namespace render {
+Timeline::Timeline(const vk::raii::Device& device, const vk::raii::Queue& queue,
+                   std::shared_ptr<std::mutex> pQueueMutex)
+    : _device(device), _queue(queue), _pQueueMutex(pQueueMutex) {
+    createSemaphore();
+}
+
+void Timeline::createSemaphore() {
+    try {
+        vk::SemaphoreTypeCreateInfo semaphoreTypeInfo;
+        semaphoreTypeInfo.semaphoreType = vk::SemaphoreType::eTimeline;
+        semaphoreTypeInfo.initialValue = 0;
+        vk::SemaphoreCreateInfo semaphoreInfo;
+        semaphoreInfo.pNext = &semaphoreTypeInfo;
+        _semaphore = _device.createSemaphore(semaphoreInfo);
+    } catch (std::exception& e) {
+        std::cerr << "Error while creating timeline : " << e.what() << '\n';
+        exit(-1);
+    }
+}
+
+uint64_t Timeline::submit(const std::vector<vk::CommandBuffer>& commandBuffers,
+                          const std::vector<SemaphoreWait>& waits,
+                          const std::vector<vk::Semaphore>& binarySignals) {
+    std::vector<vk::Semaphore> waitSemaphores;
+    std::vector<vk::PipelineStageFlags> waitStages;
+    std::vector<uint64_t> waitValues;
+    for (const SemaphoreWait& wait : waits) {
+        waitSemaphores.push_back(wait.semaphore);
+        waitStages.push_back(wait.stage);
+        waitValues.push_back(wait.value);
+    }
+    std::vector<vk::Semaphore> signalSemaphores = binarySignals;
+    signalSemaphores.push_back(*_semaphore);
+    std::vector<uint64_t> signalValues(signalSemaphores.size(), 0);
+
+    std::lock_guard<std::mutex> lock(*_pQueueMutex);
+    uint64_t value = _submitted.load(std::memory_order_relaxed) + 1;
+    signalValues.back() = value;
+    vk::TimelineSemaphoreSubmitInfo timelineInfo;
+    timelineInfo.setWaitSemaphoreValues(waitValues);
+    timelineInfo.setSignalSemaphoreValues(signalValues);
+    vk::SubmitInfo submitInfo;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.setWaitSemaphores(waitSemaphores);
+    submitInfo.setWaitDstStageMask(waitStages);
+    submitInfo.setCommandBuffers(commandBuffers);
+    submitInfo.setSignalSemaphores(signalSemaphores);
+    _queue.submit(submitInfo, nullptr);
+    _submitted.store(value, std::memory_order_release);
+    return value;
+}
+
+uint64_t Timeline::completed() const {
+    return _semaphore.getCounterValue();
+}
+
+void Timeline::wait(uint64_t value) const {
+    if (reached(value)) return;
+    vk::SemaphoreWaitInfo waitInfo;
+    waitInfo.setSemaphores(*_semaphore);
+    waitInfo.setValues(value);
+    if (_device.waitSemaphores(waitInfo, std::numeric_limits<uint64_t>::max()) !=
+        vk::Result::eSuccess) {
+        std::cerr << "Error while waiting for a timeline value\n";
+        exit(-1);
+    }
+}
+} // namespace render
\ No newline at end of file
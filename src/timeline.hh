@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace render {
+// Wait of a submission, the value is ignored for binary semaphores
+struct SemaphoreWait {
+    vk::Semaphore semaphore;
+    uint64_t value;
+    vk::PipelineStageFlags stage;
+};
+
+// Timeline semaphore of a queue. Every submission through it signals the next value, so a value
+// is reached once its submission and all the earlier ones have completed. The CPU and the other
+// queues wait on values instead of fences.
+class Timeline {
+private:
+    const vk::raii::Device& _device;
+    const vk::raii::Queue& _queue;
+    std::shared_ptr<std::mutex> _pQueueMutex; // shared by everything submitting to the queue
+    vk::raii::Semaphore _semaphore = 0;
+    std::atomic<uint64_t> _submitted{0};
+
+    void createSemaphore();
+
+public:
+    Timeline(const vk::raii::Device& device, const vk::raii::Queue& queue,
+             std::shared_ptr<std::mutex> pQueueMutex);
+    Timeline(const Timeline&) = delete;
+    Timeline& operator=(const Timeline&) = delete;
+
+    // Submits the command buffers after the waits, signals the binary semaphores and the next
+    // value of the timeline, which is returned. Can be called from any thread.
+    uint64_t submit(const std::vector<vk::CommandBuffer>& commandBuffers,
+                    const std::vector<SemaphoreWait>& waits = {},
+                    const std::vector<vk::Semaphore>& binarySignals = {});
+
+    // Value of the last submission
+    uint64_t submitted() const {
+        return _submitted.load(std::memory_order_acquire);
+    }
+    // Value the GPU has reached, a single counter query
+    uint64_t completed() const;
+    bool reached(uint64_t value) const {
+        return value == 0 || completed() >= value;
+    }
+    // Blocks until the value is reached
+    void wait(uint64_t value) const;
+
+    const vk::raii::Semaphore& semaphore() const {
+        return _semaphore;
+    }
+    // Held by other operations on the queue, such as presentation
+    std::mutex& queueMutex() const {
+        return *_pQueueMutex;
+    }
+};
+} // namespace render
\ No newline at end of file
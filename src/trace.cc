@@ -0,0 +1,154 @@
+#include "trace.hh"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "json_writer.hh"
+
+namespace render {
+std::atomic<bool> Tracer::_enabled{false};
+std::atomic<bool> Tracer::_dumpRequested{false};
+
+namespace {
+struct TraceEvent {
+    const char* name;
+    uint64_t startNs;
+    uint64_t endNs;
+};
+
+// events of a thread are allocated in chunks as it records them, a trace run with many threads
+// does not reserve the whole limit of every thread up front
+constexpr size_t EVENTS_PER_CHUNK = 4096;
+
+// Only the owning thread writes, an event is immutable once count covers it. The chunk table is
+// sized once, a chunk is allocated before count covers its first event.
+struct ThreadBuffer {
+    std::vector<std::unique_ptr<TraceEvent[]>> chunks;
+    size_t capacity = 0;
+    std::atomic<size_t> count{0};
+    std::atomic<size_t> dropped{0};
+    uint32_t threadId;
+    std::string threadName;
+};
+
+struct TraceRegistry {
+    std::mutex mutex; // only taken when a thread records its first event and when dumping
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    size_t eventsPerThread = 0;
+};
+
+TraceRegistry& registry() {
+    static TraceRegistry traceRegistry;
+    return traceRegistry;
+}
+
+ThreadBuffer& threadBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer;
+    if (!buffer) {
+        TraceRegistry& traceRegistry = registry();
+        std::lock_guard<std::mutex> lock(traceRegistry.mutex);
+        buffer = std::make_shared<ThreadBuffer>();
+        buffer->capacity = traceRegistry.eventsPerThread;
+        buffer->chunks.resize((buffer->capacity + EVENTS_PER_CHUNK - 1) / EVENTS_PER_CHUNK);
+        buffer->threadId = (uint32_t)traceRegistry.buffers.size() + 1;
+        buffer->threadName = "thread " + std::to_string(buffer->threadId);
+        traceRegistry.buffers.push_back(buffer);
+    }
+    return *buffer;
+}
+} // namespace
+
+void Tracer::enable(size_t eventsPerThread) {
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        registry().eventsPerThread = eventsPerThread;
+    }
+    _enabled.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::disable() {
+    _enabled.store(false, std::memory_order_relaxed);
+}
+
+uint64_t Tracer::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void Tracer::record(const char* name, uint64_t startNs, uint64_t endNs) {
+    ThreadBuffer& buffer = threadBuffer();
+    size_t index = buffer.count.load(std::memory_order_relaxed);
+    if (index >= buffer.capacity) {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    std::unique_ptr<TraceEvent[]>& chunk = buffer.chunks[index / EVENTS_PER_CHUNK];
+    if (!chunk) chunk = std::make_unique<TraceEvent[]>(EVENTS_PER_CHUNK);
+    chunk[index % EVENTS_PER_CHUNK] = TraceEvent{name, startNs, endNs};
+    buffer.count.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::setThreadName(const std::string& name) {
+    ThreadBuffer& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    buffer.threadName = name;
+}
+
+bool Tracer::writeChromeTrace(const std::string& path) {
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    std::vector<std::string> threadNames;
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        buffers = registry().buffers;
+        for (const auto& buffer : buffers) threadNames.push_back(buffer->threadName);
+    }
+    std::ofstream ofs(path);
+    JsonWriter writer(ofs);
+    writer.beginObject();
+    writer.key("displayTimeUnit").value("ms");
+    writer.key("traceEvents").beginArray();
+    size_t eventCount = 0;
+    size_t droppedCount = 0;
+    for (size_t i = 0; i < buffers.size(); i++) {
+        const ThreadBuffer& buffer = *buffers[i];
+        writer.beginObject();
+        writer.key("name").value("thread_name");
+        writer.key("ph").value("M");
+        writer.key("pid").value(1);
+        writer.key("tid").value(buffer.threadId);
+        writer.key("args").beginObject().key("name").value(threadNames[i]).endObject();
+        writer.endObject();
+
+        size_t count = buffer.count.load(std::memory_order_acquire);
+        for (size_t j = 0; j < count; j++) {
+            const TraceEvent& event = buffer.chunks[j / EVENTS_PER_CHUNK][j % EVENTS_PER_CHUNK];
+            writer.beginObject();
+            writer.key("name").value(event.name);
+            writer.key("ph").value("X");
+            writer.key("pid").value(1);
+            writer.key("tid").value(buffer.threadId);
+            writer.key("ts").value(event.startNs / 1000.0);
+            writer.key("dur").value((event.endNs - event.startNs) / 1000.0);
+            writer.endObject();
+        }
+        eventCount += count;
+        droppedCount += buffer.dropped.load(std::memory_order_relaxed);
+    }
+    writer.endArray();
+    writer.endObject();
+    ofs << '\n';
+    if (!ofs) {
+        std::cerr << "Error while writing trace " << path << '\n';
+        return false;
+    }
+    std::cout << "Wrote " << eventCount << " trace events to " << path;
+    if (droppedCount) std::cout << " (" << droppedCount << " dropped, buffers were full)";
+    std::cout << '\n';
+    return true;
+}
+} // namespace render
\ No newline at end of file
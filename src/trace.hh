@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace render {
+// Collects timed scopes into per-thread buffers and dumps them as a Chrome trace-event JSON
+// (about:tracing, ui.perfetto.dev). While disabled a scope costs a relaxed load and a branch so
+// the macros can stay in production builds.
+class Tracer {
+private:
+    static std::atomic<bool> _enabled;
+    static std::atomic<bool> _dumpRequested;
+
+public:
+    // Starts recording, each thread keeps at most eventsPerThread events and drops the rest.
+    // Memory grows with the events actually recorded.
+    static void enable(size_t eventsPerThread = 1 << 20);
+    static void disable();
+    static bool enabled() {
+        return _enabled.load(std::memory_order_relaxed);
+    }
+
+    static uint64_t now();
+    static void record(const char* name, uint64_t startNs, uint64_t endNs);
+    // Names the calling thread in the trace
+    static void setThreadName(const std::string& name);
+
+    // Can be called from a signal handler, the owner of the loop dumps when it sees it
+    static void requestDump() {
+        _dumpRequested.store(true, std::memory_order_relaxed);
+    }
+    static bool consumeDumpRequest() {
+        return _dumpRequested.exchange(false, std::memory_order_relaxed);
+    }
+    // Writes every event recorded so far, can run while other threads keep recording
+    static bool writeChromeTrace(const std::string& path);
+};
+
+class TraceScope {
+private:
+    const char* _name;
+    uint64_t _start = 0;
+    bool _active;
+
+public:
+    // name must outlive the tracer, string literals are expected
+    TraceScope(const char* name) : _name(name), _active(Tracer::enabled()) {
+        if (_active) _start = Tracer::now();
+    }
+    ~TraceScope() {
+        if (_active) Tracer::record(_name, _start, Tracer::now());
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+};
+} // namespace render
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SCOPE(name) render::TraceScope TRACE_CONCAT(traceScope, __COUNTER__)(name)
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace render {
+// Lock-free handoff of the latest value from one producer thread to one consumer thread. Each
+// side owns a slot, the third one holds the last published value. Publishing and taking swap
+// slots with a single atomic exchange so neither side ever waits, values published faster than
+// they are taken are skipped.
+template <typename T>
+class TripleBuffer {
+private:
+    static constexpr uint8_t INDEX_MASK = 0x3;
+    static constexpr uint8_t FRESH = 0x4; // the middle slot was published and not taken yet
+
+    std::array<T, 3> _slots{};
+    std::atomic<uint8_t> _middle{1};
+    uint8_t _back = 0;  // written by the producer
+    uint8_t _front = 2; // read by the consumer
+
+public:
+    // Producer side, the slot to fill before publishing it
+    T& back() {
+        return _slots[_back];
+    }
+    void publish() {
+        _back = _middle.exchange(_back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // Consumer side, moves to the latest published value, false when there is none since the
+    // previous take
+    bool take() {
+        if (!(_middle.load(std::memory_order_relaxed) & FRESH)) return false;
+        _front = _middle.exchange(_front, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+    const T& front() const {
+        return _slots[_front];
+    }
+};
+} // namespace render
\ No newline at end of file
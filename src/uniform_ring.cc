@@ -0,0 +1,82 @@
+#include "uniform_ring.hh"
+
+#include <algorithm>
+#include <iostream>
+
+namespace render {
+UniformRing::UniformRing(std::shared_ptr<const render::Device> pDevice,
+                         const vk::raii::DescriptorSetLayout& layout, uint32_t framesInFlight,
+                         uint32_t allocationsPerFrame, vk::DeviceSize range)
+    : _pDevice(pDevice), _range(range) {
+    _alignment = std::max<vk::DeviceSize>(
+        _pDevice->physicalDevice().getProperties().limits.minUniformBufferOffsetAlignment, 1);
+    vk::DeviceSize slice = (_range + _alignment - 1) / _alignment * _alignment;
+    _frameSize = slice * std::max(allocationsPerFrame, 1u);
+    createBuffer(framesInFlight);
+    createDescriptorSet(layout);
+}
+
+void UniformRing::createBuffer(uint32_t framesInFlight) {
+    _pBuffer = std::make_unique<render::HostBuffer>(*_pDevice, _frameSize * framesInFlight,
+                                                    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+}
+
+void UniformRing::createDescriptorSet(const vk::raii::DescriptorSetLayout& layout) {
+    try {
+        vk::DescriptorPoolSize poolSize;
+        poolSize.type = vk::DescriptorType::eUniformBufferDynamic;
+        poolSize.descriptorCount = 1;
+        vk::DescriptorPoolCreateInfo descriptorPoolInfo;
+        descriptorPoolInfo.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+        descriptorPoolInfo.maxSets = 1;
+        descriptorPoolInfo.setPoolSizes(poolSize);
+        _descriptorPool = _pDevice->device().createDescriptorPool(descriptorPoolInfo);
+
+        vk::DescriptorSetAllocateInfo descriptorSetInfo;
+        descriptorSetInfo.descriptorPool = *_descriptorPool;
+        descriptorSetInfo.setSetLayouts(*layout);
+        _descriptorSet =
+            std::move(_pDevice->device().allocateDescriptorSets(descriptorSetInfo).at(0));
+
+        vk::DescriptorBufferInfo bufferInfo;
+        bufferInfo.buffer = _pBuffer->buffer();
+        bufferInfo.offset = 0;
+        bufferInfo.range = _range;
+        vk::WriteDescriptorSet write;
+        write.dstSet = *_descriptorSet;
+        write.dstBinding = 0;
+        write.descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+        write.setBufferInfo(bufferInfo);
+        _pDevice->device().updateDescriptorSets(write, nullptr);
+    } catch (std::exception& e) {
+        std::cerr << "Error while creating uniform descriptor set : " << e.what() << '\n';
+        exit(-1);
+    }
+}
+
+void UniformRing::beginFrame(uint32_t frameIndex) {
+    _frameBegin = _frameSize * frameIndex;
+    _cursor.store(_frameBegin, std::memory_order_relaxed);
+}
+
+UniformAllocation UniformRing::allocate(vk::DeviceSize size) {
+    vk::DeviceSize slice = (size + _alignment - 1) / _alignment * _alignment;
+    vk::DeviceSize offset = _cursor.fetch_add(slice, std::memory_order_relaxed);
+    if (size > _range || offset + size > _frameBegin + _frameSize) {
+        std::cerr << "Uniform ring overflow : " << size << " bytes requested, "
+                  << _frameBegin + _frameSize - std::min(offset, _frameBegin + _frameSize)
+                  << " left in the frame\n";
+        exit(-1);
+    }
+    UniformAllocation allocation;
+    allocation.offset = (uint32_t)offset;
+    allocation.data = static_cast<uint8_t*>(_pBuffer->mapped()) + offset;
+    return allocation;
+}
+
+void UniformRing::flush() const {
+    vk::DeviceSize cursor =
+        std::min(_cursor.load(std::memory_order_relaxed), _frameBegin + _frameSize);
+    if (cursor > _frameBegin) _pBuffer->flush(_frameBegin, cursor - _frameBegin);
+}
+} // namespace render
\ No newline at end of file
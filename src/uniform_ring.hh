@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "device.hh"
+#include "buffer.hh"
+
+namespace render {
+struct UniformAllocation {
+    uint32_t offset; // dynamic offset to bind the descriptor set with
+    void* data;      // where to write the uniforms
+};
+
+// Persistently mapped uniform memory split in one segment per frame in flight. Every draw takes
+// an aligned slice of the current segment and binds the single descriptor set with its offset,
+// so per draw uniforms need neither allocations nor descriptor writes. Allocating is a single
+// atomic add, the recording threads of a frame share the segment.
+class UniformRing {
+private:
+    std::shared_ptr<const render::Device> _pDevice;
+    vk::DeviceSize _range;      // largest allocation, the size the descriptor covers
+    vk::DeviceSize _alignment;  // minUniformBufferOffsetAlignment
+    vk::DeviceSize _frameSize;  // bytes of a segment
+    std::unique_ptr<render::HostBuffer> _pBuffer;
+    vk::raii::DescriptorPool _descriptorPool = 0;
+    vk::raii::DescriptorSet _descriptorSet = 0;
+    vk::DeviceSize _frameBegin = 0;
+    std::atomic<vk::DeviceSize> _cursor{0};
+
+    void createBuffer(uint32_t framesInFlight);
+    void createDescriptorSet(const vk::raii::DescriptorSetLayout& layout);
+
+public:
+    UniformRing(std::shared_ptr<const render::Device> pDevice,
+                const vk::raii::DescriptorSetLayout& layout, uint32_t framesInFlight,
+                uint32_t allocationsPerFrame, vk::DeviceSize range);
+    UniformRing(const UniformRing&) = delete;
+    UniformRing& operator=(const UniformRing&) = delete;
+
+    // Starts writing into the segment of a frame slot, its previous frame must have completed
+    void beginFrame(uint32_t frameIndex);
+    // size must not exceed the range, exits when the segment is full. Can be called from any
+    // thread between beginFrame and flush.
+    UniformAllocation allocate(vk::DeviceSize size);
+    // Makes the writes of the current segment visible to the device, before submitting
+    void flush() const;
+
+    const vk::raii::DescriptorSet& descriptorSet() const {
+        return _descriptorSet;
+    }
+};
+} // namespace render
\ No newline at end of file
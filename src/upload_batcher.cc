@@ -0,0 +1,342 @@
+#include "upload_batcher.hh"
+
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include "dirty_ranges.hh"
+#include "trace.hh"
+
+namespace render {
+// a batch is flushed early once it holds a quarter of the ring, so a large upload keeps filling
+// the ring while its first bytes are being copied
+constexpr vk::DeviceSize BATCH_DIVISOR = 4;
+
+void UploadStats::print(std::ostream& os) const {
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << "UPLOADS : " << submitCount << " submits, " << regionCount << " regions, " << std::fixed
+       << std::setprecision(1) << bytes / (1024.0 * 1024.0) << " MiB";
+    if (submitCount) {
+        os << ", " << (double)regionCount / submitCount << " regions and "
+           << bytes / 1024.0 / submitCount << " KiB per submit";
+    }
+    os << ", " << stallCount << " stalls";
+    if (spillCount) {
+        os << ", " << spillCount << " spills (" << spillBytes / (1024.0 * 1024.0) << " MiB, "
+           << spillAllocationNs / 1000.0 / spillCount << " us per allocation)";
+    }
+    if (movedBytes) os << ", " << movedBytes / (1024.0 * 1024.0) << " MiB moved";
+    os << '\n';
+    os << "  " << directBuffers << " buffers written directly (" << std::setprecision(1)
+       << directBytes / (1024.0 * 1024.0) << " MiB), " << stagedBuffers
+       << " through staging\n";
+    os.flags(flags);
+    os.precision(precision);
+}
+
+void UploadStats::writeJson(JsonWriter& writer) const {
+    writer.beginObject();
+    writer.key("submits").value(submitCount);
+    writer.key("regions").value(regionCount);
+    writer.key("bytes").value(bytes);
+    writer.key("bytes_per_submit").value(submitCount ? (double)bytes / submitCount : 0.0);
+    writer.key("stalls").value(stallCount);
+    writer.key("spills").value(spillCount);
+    writer.key("spill_bytes").value(spillBytes);
+    writer.key("spill_allocation_ns").value(spillAllocationNs);
+    writer.key("direct_buffers").value(directBuffers);
+    writer.key("staged_buffers").value(stagedBuffers);
+    writer.key("direct_bytes").value(directBytes);
+    writer.key("moved_bytes").value(movedBytes);
+    writer.endObject();
+}
+
+UploadBatcher::UploadBatcher(const vk::raii::Device& device, VmaAllocator allocator,
+                             render::Timeline& timeline, uint32_t queueFamilyIndex,
+                             uint32_t graphicsQueueFamilyIndex, bool releaseOwnership,
+                             vk::DeviceSize stagingCapacity, VmaPool spillPool)
+    : _device(device),
+      _allocator(allocator),
+      _timeline(timeline),
+      _queueFamilyIndex(queueFamilyIndex),
+      _graphicsQueueFamilyIndex(graphicsQueueFamilyIndex),
+      _releaseOwnership(releaseOwnership),
+      _stagingRing(allocator, stagingCapacity),
+      _spillPool(spillPool) {
+    createCommandPool(queueFamilyIndex);
+}
+
+UploadBatcher::~UploadBatcher() {
+    wait(flush());
+    // wait returns early when the batches already completed, the spills are still to be freed
+    std::lock_guard<std::mutex> lock(_mutex);
+    retire(_serial);
+}
+
+void UploadBatcher::createCommandPool(uint32_t queueFamilyIndex) {
+    try {
+        vk::CommandPoolCreateInfo commandPoolInfo;
+        commandPoolInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer |
+                                vk::CommandPoolCreateFlagBits::eTransient;
+        commandPoolInfo.queueFamilyIndex = queueFamilyIndex;
+        _commandPool = _device.createCommandPool(commandPoolInfo);
+    } catch (std::exception& e) {
+        std::cerr << "Error while creating upload command pool : " << e.what() << '\n';
+        exit(-1);
+    }
+}
+
+vk::raii::CommandBuffer UploadBatcher::takeCommandBuffer() {
+    if (!_freeCommandBuffers.empty()) {
+        vk::raii::CommandBuffer commandBuffer = std::move(_freeCommandBuffers.back());
+        _freeCommandBuffers.pop_back();
+        return commandBuffer;
+    }
+    try {
+        vk::CommandBufferAllocateInfo commandBufferAllocInfo;
+        commandBufferAllocInfo.level = vk::CommandBufferLevel::ePrimary;
+        commandBufferAllocInfo.commandPool = *_commandPool;
+        commandBufferAllocInfo.commandBufferCount = 1;
+        return std::move(_device.allocateCommandBuffers(commandBufferAllocInfo).at(0));
+    } catch (std::exception& e) {
+        std::cerr << "Error while creating upload command buffer : " << e.what() << '\n';
+        exit(-1);
+    }
+}
+
+void UploadBatcher::retire(uint64_t completedValue) {
+    _stagingRing.release(completedValue);
+    while (!_spills.empty() && _spills.front().serial != 0 &&
+           _spills.front().serial <= completedValue) {
+        vmaDestroyBuffer(_allocator, _spills.front().buffer, _spills.front().allocation);
+        _spills.pop_front();
+    }
+    while (!_inFlight.empty() && _inFlight.front().serial <= completedValue) {
+        _freeCommandBuffers.push_back(std::move(_inFlight.front().commandBuffer));
+        _inFlight.pop_front();
+    }
+}
+
+bool UploadBatcher::trySpill(vk::DeviceSize size) {
+    if (_spillPool == VK_NULL_HANDLE) return false;
+    VkBufferCreateInfo bufferCreateInfo{};
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.size = size;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocCreateInfo{};
+    allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+    allocCreateInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                            VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    allocCreateInfo.pool = _spillPool;
+
+    VkBuffer buffer;
+    VmaAllocation allocation;
+    VmaAllocationInfo allocationInfo;
+    uint64_t start = Tracer::now();
+    // fails without allocating new memory once the single block of the pool is full
+    VkResult result = vmaCreateBuffer(_allocator, &bufferCreateInfo, &allocCreateInfo, &buffer,
+                                      &allocation, &allocationInfo);
+    _stats.spillAllocationNs += Tracer::now() - start;
+    if (result != VkResult::VK_SUCCESS) return false;
+    _spills.push_back(Spill{0, vk::Buffer(buffer), allocation,
+                            static_cast<uint8_t*>(allocationInfo.pMappedData)});
+    _stats.spillCount++;
+    _stats.spillBytes += size;
+    return true;
+}
+
+uint8_t* UploadBatcher::reserve(vk::DeviceSize size, vk::Buffer& buffer,
+                                vk::DeviceSize& offset) {
+    retire(_timeline.completed());
+    bool stalled = false;
+    while (!_stagingRing.tryReserve(size, offset)) {
+        if (trySpill(size)) {
+            buffer = _spills.back().buffer;
+            offset = 0;
+            return _spills.back().mapped;
+        }
+        if (!stalled) {
+            _stats.stallCount++;
+            stalled = true;
+        }
+        // the pending batch may be what fills the ring
+        if (_stagingRing.oldestSerial() == 0) flushLocked();
+        uint64_t oldest = _stagingRing.oldestSerial();
+        _timeline.wait(oldest);
+        retire(oldest);
+    }
+    buffer = _stagingRing.buffer();
+    return _stagingRing.mapped() + offset;
+}
+
+void UploadBatcher::recordReleases(const vk::raii::CommandBuffer& commandBuffer) {
+    // the transfer family never read the ranges, their previous content is overwritten so the
+    // graphics family does not need to release them first
+    std::map<vk::Buffer, render::DirtyRanges> written;
+    for (const auto& [buffers, regions] : _pendingCopies) {
+        render::DirtyRanges& ranges = written[buffers.second];
+        for (const vk::BufferCopy& region : regions) ranges.add(region.dstOffset, region.size);
+    }
+    std::vector<vk::BufferMemoryBarrier> releases;
+    for (auto& [dst, ranges] : written) {
+        for (const render::ByteRange& range : ranges.take()) {
+            vk::BufferMemoryBarrier barrier;
+            barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+            barrier.srcQueueFamilyIndex = _queueFamilyIndex;
+            barrier.dstQueueFamilyIndex = _graphicsQueueFamilyIndex;
+            barrier.buffer = dst;
+            barrier.offset = range.offset;
+            barrier.size = range.size;
+            releases.push_back(barrier);
+
+            barrier.srcAccessMask = vk::AccessFlags();
+            barrier.dstAccessMask =
+                vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead;
+            _pendingAcquires.push_back(barrier);
+        }
+    }
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                  vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, releases, {});
+}
+
+// orders the transfers of the batch after the ones of the previous batches, and the copies of
+// the batch after its moves
+static void recordTransferBarrier(const vk::raii::CommandBuffer& commandBuffer) {
+    vk::MemoryBarrier barrier;
+    barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite;
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                  vk::PipelineStageFlagBits::eTransfer, {}, barrier, {}, {});
+}
+
+void UploadBatcher::flushLocked() {
+    if (_pendingCopies.empty() && _pendingMoves.empty()) return;
+    TRACE_SCOPE("UploadBatcher::flush");
+    vk::raii::CommandBuffer commandBuffer = takeCommandBuffer();
+    vk::CommandBufferBeginInfo beginInfo;
+    beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+    commandBuffer.begin(beginInfo);
+    // a range written by two batches, or moved then written, must end with the latest bytes
+    recordTransferBarrier(commandBuffer);
+    if (!_pendingMoves.empty()) {
+        for (const Move& move : _pendingMoves) {
+            commandBuffer.copyBuffer(move.src, move.dst, vk::BufferCopy(0, 0, move.size));
+            _stats.movedBytes += move.size;
+        }
+        recordTransferBarrier(commandBuffer);
+    }
+    for (const auto& [buffers, regions] : _pendingCopies) {
+        commandBuffer.copyBuffer(buffers.first, buffers.second, regions);
+        _stats.regionCount += regions.size();
+    }
+    if (_releaseOwnership) recordReleases(commandBuffer);
+    commandBuffer.end();
+
+    uint64_t signalValue = _timeline.submit({*commandBuffer});
+    if (_releaseOwnership) _acquireSerial = signalValue;
+
+    _serial = signalValue;
+    _stagingRing.close(signalValue);
+    // the spills of the batch are the last ones taken
+    for (auto it = _spills.rbegin(); it != _spills.rend() && it->serial == 0; ++it) {
+        it->serial = signalValue;
+    }
+    _inFlight.push_back(Batch{signalValue, std::move(commandBuffer)});
+    _stats.submitCount++;
+    _stats.bytes += _pendingBytes;
+    _pendingCopies.clear();
+    _pendingMoves.clear();
+    _pendingBytes = 0;
+}
+
+UploadToken UploadBatcher::upload(const void* data, vk::DeviceSize size, vk::Buffer dst,
+                                  vk::DeviceSize dstOffset) {
+    TRACE_SCOPE("UploadBatcher::upload");
+    std::lock_guard<std::mutex> lock(_mutex);
+    const uint8_t* source = static_cast<const uint8_t*>(data);
+    const vk::DeviceSize maxBatch =
+        std::max<vk::DeviceSize>(_stagingRing.capacity() / BATCH_DIVISOR, 1);
+    vk::DeviceSize done = 0;
+    while (done < size) {
+        vk::DeviceSize chunk = std::min(size - done, maxBatch);
+        vk::Buffer staging;
+        vk::DeviceSize offset;
+        std::memcpy(reserve(chunk, staging, offset), source + done, chunk);
+        if (staging == _stagingRing.buffer()) {
+            _stagingRing.flush(offset, chunk);
+        } else {
+            vmaFlushAllocation(_allocator, _spills.back().allocation, 0, chunk);
+        }
+
+        vk::BufferCopy copyRegion;
+        copyRegion.srcOffset = offset;
+        copyRegion.dstOffset = dstOffset + done;
+        copyRegion.size = chunk;
+        _pendingCopies[{staging, dst}].push_back(copyRegion);
+        _pendingBytes += chunk;
+        done += chunk;
+        if (_pendingBytes >= maxBatch) flushLocked();
+    }
+    // the pending batch will signal the next value
+    return UploadToken{_pendingCopies.empty() ? _serial : _serial + 1};
+}
+
+UploadToken UploadBatcher::move(vk::Buffer src, vk::Buffer dst, vk::DeviceSize size) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pendingMoves.push_back(Move{src, dst, size});
+    return UploadToken{_serial + 1};
+}
+
+UploadToken UploadBatcher::flush() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    flushLocked();
+    return UploadToken{_serial};
+}
+
+void UploadBatcher::wait(const UploadToken& token) {
+    if (completed(token)) return;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (token.value > _serial) flushLocked();
+    }
+    _timeline.wait(token.value);
+    std::lock_guard<std::mutex> lock(_mutex);
+    retire(token.value);
+}
+
+UploadToken UploadBatcher::pendingToken() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    bool pending = !_pendingCopies.empty() || !_pendingMoves.empty();
+    return UploadToken{pending ? _serial + 1 : _serial};
+}
+
+bool UploadBatcher::completed(const UploadToken& token) const {
+    return _timeline.reached(token.value);
+}
+
+std::vector<vk::BufferMemoryBarrier> UploadBatcher::takeAcquireBarriers(UploadToken& token) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    token = UploadToken{_pendingAcquires.empty() ? 0 : _acquireSerial};
+    std::vector<vk::BufferMemoryBarrier> acquires;
+    acquires.swap(_pendingAcquires);
+    return acquires;
+}
+
+void UploadBatcher::countBuffer(bool direct) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    (direct ? _stats.directBuffers : _stats.stagedBuffers)++;
+}
+
+void UploadBatcher::countDirectWrite(vk::DeviceSize size) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stats.directBytes += size;
+}
+
+UploadStats UploadBatcher::stats() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+} // namespace render
\ No newline at end of file
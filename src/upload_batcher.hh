@@ -0,0 +1,151 @@
+#pragma once
+
+#include <vulkan/vulkan_raii.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "staging_ring.hh"
+#include "timeline.hh"
+#include "json_writer.hh"
+
+#include "vk_mem_alloc.h"
+
+namespace render {
+// Completion of an upload, the value its batch signals on the transfer timeline.
+// The default token is already complete.
+struct UploadToken {
+    uint64_t value = 0;
+
+    void merge(const UploadToken& other) {
+        value = std::max(value, other.value);
+    }
+};
+
+struct UploadStats {
+    uint64_t submitCount = 0;
+    uint64_t regionCount = 0;
+    uint64_t bytes = 0;
+    uint64_t stallCount = 0; // uploads which waited for older copies to free staging space
+    // buffers of the streaming pool taking the writes the ring had no room for, and the time
+    // spent creating them
+    uint64_t spillCount = 0;
+    uint64_t spillBytes = 0;
+    uint64_t spillAllocationNs = 0;
+    // buffers the host writes directly, skipping staging, and buffers written through transfers
+    uint64_t directBuffers = 0;
+    uint64_t stagedBuffers = 0;
+    uint64_t directBytes = 0;
+    uint64_t movedBytes = 0; // defragmentation copies
+
+    void print(std::ostream& os) const;
+    void writeJson(JsonWriter& writer) const;
+};
+
+// Gathers writes to any number of device local buffers. Their data is packed into the staging
+// ring as soon as they are queued, a flush records every pending write in one command buffer
+// with one multi-region copy per staging buffer and destination and submits it to the transfer
+// queue without waiting. The batch signals the transfer timeline, consumers wait on the token of
+// their write either on the GPU or on the host. The batcher is the only submitter of that
+// timeline, so the value of the pending batch is known before it is flushed.
+// With exclusive buffers on a dedicated transfer family every batch releases the written ranges
+// to the graphics family, the next graphics submission records the matching acquires.
+// A write the ring has no room for is staged in a buffer of its own taken from the streaming
+// pool rather than waiting for older copies, the stall only happens once that pool is full.
+class UploadBatcher {
+private:
+    struct Batch {
+        uint64_t serial;
+        vk::raii::CommandBuffer commandBuffer;
+    };
+    struct Spill {
+        uint64_t serial; // batch reading it, 0 until flushed
+        vk::Buffer buffer;
+        VmaAllocation allocation;
+        uint8_t* mapped;
+    };
+
+    const vk::raii::Device& _device;
+    VmaAllocator _allocator;
+    render::Timeline& _timeline;
+    uint32_t _queueFamilyIndex;
+    uint32_t _graphicsQueueFamilyIndex;
+    bool _releaseOwnership;
+    render::StagingRing _stagingRing;
+    VmaPool _spillPool;
+    vk::raii::CommandPool _commandPool = 0;
+
+    mutable std::mutex _mutex;
+    uint64_t _serial = 0; // value of the last submitted batch
+    // by staging source and destination
+    std::map<std::pair<vk::Buffer, vk::Buffer>, std::vector<vk::BufferCopy>> _pendingCopies;
+    struct Move {
+        vk::Buffer src;
+        vk::Buffer dst;
+        vk::DeviceSize size;
+    };
+    std::vector<Move> _pendingMoves; // recorded before the copies of their batch
+    vk::DeviceSize _pendingBytes = 0;
+    std::deque<Batch> _inFlight;
+    std::deque<Spill> _spills; // in allocation order, which is the order the pool frees them in
+    std::vector<vk::raii::CommandBuffer> _freeCommandBuffers;
+    std::vector<vk::BufferMemoryBarrier> _pendingAcquires;
+    uint64_t _acquireSerial = 0; // batch releasing the pending acquires
+    UploadStats _stats;
+
+    void createCommandPool(uint32_t queueFamilyIndex);
+    vk::raii::CommandBuffer takeCommandBuffer();
+    // staging range of size bytes in the ring or in a spill buffer, flushes and waits for older
+    // batches until they fit
+    uint8_t* reserve(vk::DeviceSize size, vk::Buffer& buffer, vk::DeviceSize& offset);
+    bool trySpill(vk::DeviceSize size);
+    void retire(uint64_t completedValue);
+    void recordReleases(const vk::raii::CommandBuffer& commandBuffer);
+    void flushLocked();
+
+public:
+    UploadBatcher(const vk::raii::Device& device, VmaAllocator allocator,
+                  render::Timeline& timeline, uint32_t queueFamilyIndex,
+                  uint32_t graphicsQueueFamilyIndex, bool releaseOwnership,
+                  vk::DeviceSize stagingCapacity, VmaPool spillPool = VK_NULL_HANDLE);
+    ~UploadBatcher();
+    UploadBatcher(const UploadBatcher&) = delete;
+    UploadBatcher& operator=(const UploadBatcher&) = delete;
+
+    // Copies data into staging and queues its write to dst. dst must not be read before the
+    // token has completed, which needs the batch to have been flushed.
+    UploadToken upload(const void* data, vk::DeviceSize size, vk::Buffer dst,
+                       vk::DeviceSize dstOffset = 0);
+    // Queues a whole buffer copy between two device buffers, recorded ahead of the uploads of
+    // the same batch so writes queued to dst after the call land after it
+    UploadToken move(vk::Buffer src, vk::Buffer dst, vk::DeviceSize size);
+    // Submits the pending writes, the renderer flushes once per frame
+    UploadToken flush();
+    // Blocks until the upload has completed, flushing it first when needed
+    void wait(const UploadToken& token);
+    // Non blocking check of the timeline
+    bool completed(const UploadToken& token) const;
+    // Completes once every write queued so far has
+    UploadToken pendingToken() const;
+    // Acquire barriers of the ranges released by the flushed batches since the previous call,
+    // empty unless ownership is transferred. The submission recording them must wait on token,
+    // at the vertex input stage.
+    std::vector<vk::BufferMemoryBarrier> takeAcquireBarriers(UploadToken& token);
+
+    // Graphics submissions wait on it with the token value before reading uploaded data
+    const vk::raii::Semaphore& timeline() const {
+        return _timeline.semaphore();
+    }
+    // Accounting of the buffers bypassing the batcher
+    void countBuffer(bool direct);
+    void countDirectWrite(vk::DeviceSize size);
+
+    UploadStats stats() const;
+};
+} // namespace render
\ No newline at end of file